@@ -11,6 +11,17 @@
 
 #define TODO_DATA_DIR getenv("HOME")
 #define TODO_DATA_FILE ".tododata"
+#define TODO_LISTS_DIR ".todolists"
+#define TODO_MANIFEST_FILE "manifest"
+#define DEFAULT_LIST_NAME "default"
+#define MAX_LISTS 32
+#define LIST_NAME_SIZE 64
+
+// Data file format
+#define DATA_MAGIC "TODO"
+#define DATA_FORMAT_VERSION 5
+#define MAX_TAGS 64
+#define TAG_NAME_SIZE 32
 
 #define BACK_ICON "/usr/share/todo/icons/back.png"
 #define REMOVE_ICON "/usr/share/todo/icons/remove.png"
@@ -18,13 +29,60 @@
 
 #define GLOBAL_MARGIN 25.0f
 
+// Indentation of every level of subtasks
+#define SUBTASK_INDENT 25.0f
+
 #define INPUT_BUF_SIZE 512
 
+// Notes are kept in a region of the data file that is compacted once 
+// it is larger than the minimum size & mostly holds replaced notes.
+#define NOTES_COMPACT_MIN_SIZE (1 << 16)
+// Room kept free at the end of the buffer notes are edited in
+#define NOTES_EDIT_SLACK 256
+
 #define SECONDARY_COLOR (LfColor){65, 167, 204, 255} 
 
 #define DA_INIT_CAP 64 
 
 #define SMOOTH_SCROLL false
 
+// Import & export
+#define EXCHANGE_IO_BUF_SIZE (1 << 16)
+#define EXCHANGE_BUF_INIT_CAP 256
+#define IMPORT_MAX_FIELDS 64
+
+// Delta sync, removed tasks are kept in a file next to the data file
+#define DELTA_FORMAT_VERSION 1
+#define TOMBSTONE_FILE_SUFFIX ".tombstones"
+
+// Undo & redo logs next to the data file, the oldest 
+// changes are dropped once a log exceeds the maximum size.
+#define UNDO_FILE_SUFFIX ".undo"
+#define REDO_FILE_SUFFIX ".redo"
+#define UNDO_LOG_MAX_SIZE (1 << 20)
+
+// Statistics are kept in a file next to the data file, the completions 
+// of the last STATS_HISTORY_DAYS days are remembered.
+#define STATS_FILE_SUFFIX ".stats"
+#define STATS_FORMAT_VERSION 1
+#define STATS_HISTORY_DAYS 90
+// Number of days the completions are shown of
+#define STATS_SHOWN_DAYS 14
+
+// Input recording & replay. The version is raised whenever the synthetic 
+// data set changes, logs of other versions are refused.
+#define INPUT_LOG_VERSION 2
+#define REPLAY_DATA_FILE "/tmp/todo-replay-data"
+#define REPLAY_SYNTHETIC_ENTRIES 1000
+
+// Number of synthetic tasks --bench-query evaluates queries on
+#define BENCH_QUERY_ENTRIES 1000000
+
+// Command run with the title & description of a task when it is due
+#define REMINDER_CMD "notify-send"
+
+// Number of frames rendered after waking up from waiting for events
+#define REDRAW_FRAMES 2
+
 #define DATE_CMD "date +\"%d.%m.%Y, %H:%M\""
 
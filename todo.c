@@ -1,21 +1,35 @@
+#define _GNU_SOURCE
 #include <GL/gl.h>
 #include <GLFW/glfw3.h>
 #include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <leif/leif.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "config.h"
 
 typedef enum {
-  FILTER_ALL = 0,
-  FILTER_IN_PROGRESS,
-  FILTER_COMPLETED,
-  FILTER_LOW,
-  FILTER_MEDIUM,
-  FILTER_HIGH
+  FILTER_STATE_IN_PROGRESS = 1 << 0,
+  FILTER_STATE_COMPLETED = 1 << 1
+} filter_state;
+
+// Filters are combinations: entries have to match one of the 
+// selected states, one of the selected priorities and all 
+// selected tags. An empty group matches everything.
+typedef struct {
+  uint8_t states;
+  uint8_t priorities;
+  uint64_t tags;
+  bool overdue;
 } todo_filter;
 
 typedef enum {
@@ -30,11 +44,58 @@ typedef enum {
   PRIORITY_COUNT
 } entry_priority;
 
-typedef struct {
+// Fields of an entry that are synced independently of each other, 
+// the creation covers the fields that never change (id & date).
+typedef enum {
+  SYNC_CREATED = 0,
+  SYNC_DONE,
+  SYNC_DESC,
+  SYNC_PRIORITY,
+  SYNC_TAGS,
+  SYNC_DUE,
+  SYNC_PARENT,
+  SYNC_FIELD_COUNT
+} sync_field;
+
+typedef struct todo_entry {
   bool completed;
   char* desc, *date;
 
   entry_priority priority;
+
+  // Bit i is set if the entry is tagged with tag i of the list
+  uint64_t tags;
+
+  // Unix timestamp the entry is due at, 0 if it has no due date
+  int64_t due;
+
+  // Runtime state: whether the due date has passed, the entries slot 
+  // in the deadline heap (-1 if not in it) & its position in the list 
+  // as of the last index rebuild.
+  bool overdue;
+  int32_t heap_idx;
+  uint32_t pos;
+
+  // Subtasks directly follow their parent in the list, so every 
+  // subtree is a contiguous range. Only the depth & collapsed state 
+  // are stored, the parent links are restored when loading.
+  struct todo_entry* parent;
+  uint32_t depth;
+  bool collapsed;
+
+  // Number of tasks in the subtree below the entry & how many of 
+  // them are completed. Updated along the parent chain on changes.
+  uint32_t nsubtasks, nsubtasks_done;
+
+  // Stable id of the entry & the sequence number of the last change 
+  // of every synced field, see export_delta().
+  uint64_t id;
+  uint64_t seqs[SYNC_FIELD_COUNT];
+
+  // Where the notes of the entry are in the notes region of the data 
+  // file. The notes themselves are only read when they are shown.
+  uint64_t note_offset;
+  uint32_t note_size;
 } todo_entry;
 
 typedef struct {
@@ -42,6 +103,352 @@ typedef struct {
   uint32_t count, cap;
 } entries_da;
 
+typedef enum {
+  MEM_ENTRIES = 0,
+  MEM_DESCRIPTIONS,
+  MEM_DATES,
+  MEM_ARRAYS,
+  MEM_OTHER,
+  MEM_CATEGORY_COUNT
+} mem_category;
+
+// Tracked allocations are preceded by their size & category, 
+// so they can be freed without knowing either. The header 
+// keeps the alignment malloc() returns.
+typedef struct {
+  uint64_t size;
+  uint64_t category;
+} mem_header;
+
+// Bytes & number of live allocations of every category. The startup 
+// jobs allocate on worker threads, so the gauges are updated atomically.
+typedef struct {
+  int64_t bytes[MEM_CATEGORY_COUNT], count[MEM_CATEGORY_COUNT];
+  int64_t total, peak;
+} mem_gauges;
+
+typedef struct {
+  char names[MAX_TAGS][TAG_NAME_SIZE];
+  uint32_t count;
+} tag_table;
+
+// Header of a data file as read by open_todo_list()
+typedef struct {
+  uint32_t version, count;
+  // Sequence number of the last change made to the list
+  uint64_t seq;
+  // The notes region follows the header, the entries follow the notes
+  uint64_t notes_size;
+  long notes_start;
+} list_header;
+
+// Removed entries are remembered in a file next to the data file, 
+// so their removal can be synced.
+typedef struct {
+  uint64_t id, seq;
+} tombstone;
+
+// Open addressing hash map from entry ids to entries. Ids of removed 
+// entries are kept with a NULL entry & the sequence number of the removal.
+typedef struct {
+  uint64_t* keys;
+  todo_entry** values;
+  uint64_t* removed;
+  uint32_t count, cap;
+} id_map;
+
+// A change record of a delta. Fields that are not part of 
+// the record have a sequence number of 0.
+typedef struct {
+  uint64_t id, deleted;
+  uint64_t seqs[SYNC_FIELD_COUNT];
+  bool completed;
+  char* desc, *date, *tags;
+  entry_priority priority;
+  int64_t due;
+  uint64_t parent;
+} delta_record;
+
+typedef enum {
+  OP_ADD = 0,
+  OP_REMOVE,
+  OP_TOGGLE,
+  OP_PRIORITY,
+  OP_REORDER,
+  OP_TAGS,
+  OP_DUE
+} op_type;
+
+// A change of the list as stored in the undo & redo logs. The entry is 
+// looked up at the recorded position, which is exact when the changes 
+// are undone in reverse order (the id catches the other cases). Where 
+// an entry goes back to is given by its parent & next sibling (anchor). 
+// Additions & removals carry the serialized subtree, value changes the 
+// old & new value.
+typedef struct {
+  uint32_t type;
+  uint32_t pos;
+  uint64_t id, parent, anchor;
+  uint64_t before, after;
+  uint32_t payload_size;
+} list_op;
+
+typedef struct {
+  int32_t day;
+  uint32_t count;
+} day_count;
+
+// Aggregates of the loaded list, updated on every change instead of 
+// being computed from the entries. Open entries add their creation time 
+// (in minutes), so their average age follows from the sum.
+typedef struct {
+  uint32_t count, completed;
+  uint32_t priorities[PRIORITY_COUNT];
+  uint32_t open_dated;
+  int64_t open_created;
+  // Completions of the last days, indexed by the day number 
+  // modulo the history size. Slots of past days are reused.
+  day_count completions[STATS_HISTORY_DAYS];
+} list_stats;
+
+typedef struct {
+  uint64_t* words;
+  uint32_t nwords;
+} bitmap;
+
+// Bitmap index over the positions of the loaded entries. Filters are 
+// evaluated as AND/OR over these bitmaps instead of testing every entry. 
+// Changing a single entry updates its bits in place, structural changes 
+// (adding, removing, reordering, collapsing) mark the index dirty and it 
+// is rebuilt before the next evaluation. Entries inside of collapsed 
+// subtrees are not indexed at all.
+typedef struct {
+  bitmap states[2];
+  bitmap priorities[PRIORITY_COUNT];
+  bitmap tags[MAX_TAGS];
+  bitmap overdue;
+  bitmap visible;
+  bitmap result;
+  bool dirty;
+} entry_index;
+
+typedef enum {
+  QNODE_AND = 0,
+  QNODE_OR,
+  QNODE_NOT,
+  QNODE_PRED
+} query_node_type;
+
+// Parsed query expression. Predicates keep the text they were 
+// written with, the tree is compiled before it is evaluated.
+typedef struct query_node {
+  query_node_type type;
+  struct query_node* lhs, *rhs;
+  char field[16], op[3];
+  char* value;
+} query_node;
+
+typedef enum {
+  QOP_CONST = 0,
+  QOP_DONE,
+  QOP_PRIORITY,
+  QOP_TAGS,
+  QOP_DESC,
+  QOP_DUE,
+  QOP_OVERDUE,
+  QOP_NOT,
+  QOP_JUMP_IF_FALSE,
+  QOP_JUMP_IF_TRUE
+} query_opcode;
+
+typedef struct {
+  query_opcode op;
+  union {
+    bool val;
+    uint8_t priorities;
+    uint64_t tags;
+    char* needle;
+    uint32_t target;
+  } arg;
+} query_instr;
+
+// Compiled query: a flat program operating on a single result 
+// register. Every field, comparison and tag name is resolved at 
+// compile time, 'and' & 'or' compile to short circuiting jumps.
+typedef struct {
+  query_instr* code;
+  uint32_t count, cap;
+} query_program;
+
+typedef enum {
+  QTOK_END = 0,
+  QTOK_IDENT,
+  QTOK_STRING,
+  QTOK_TAG,
+  QTOK_CMP,
+  QTOK_AND,
+  QTOK_OR,
+  QTOK_NOT,
+  QTOK_LPAREN,
+  QTOK_RPAREN,
+  QTOK_ERROR
+} query_token_type;
+
+typedef struct {
+  const char* src, *pos;
+  query_token_type tok;
+  char text[INPUT_BUF_SIZE];
+  char* err;
+  size_t errsize;
+} query_parser;
+
+// Named list as stored in the manifest. Only the active 
+// list has its entries loaded, the others just carry their counts.
+typedef struct {
+  char name[LIST_NAME_SIZE];
+  uint32_t count, completed;
+} todo_list;
+
+typedef enum {
+  INPUT_LIVE = 0,
+  INPUT_RECORD,
+  INPUT_REPLAY
+} input_mode;
+
+typedef enum {
+  INPUT_EVENT_KEY = 0,
+  INPUT_EVENT_CHAR,
+  INPUT_EVENT_MOUSE_BUTTON,
+  INPUT_EVENT_CURSOR_POS,
+  INPUT_EVENT_SCROLL,
+  INPUT_EVENT_RESIZE
+} input_event_type;
+
+typedef struct {
+  uint64_t frame;
+  input_event_type type;
+  // Key: key, scancode, action, mods | Char: codepoint
+  // Mouse button: button, action, mods | Resize: width, height
+  int32_t args[4];
+  // Cursor position / scroll offsets
+  double x, y;
+} input_event;
+
+typedef struct {
+  input_event* events;
+  uint32_t count, cap;
+} input_events_da;
+
+typedef struct {
+  input_mode mode;
+  FILE* log;
+  uint64_t frame;
+
+  // Replay state
+  input_events_da events;
+  uint32_t crnt_event;
+  uint32_t synthetic_count;
+  // Whether the synthetic tasks are grouped into projects with subtasks
+  bool synthetic_tree;
+  double frame_budget_ms;
+  uint64_t end_frame;
+  double* frametimes;
+  uint64_t frametimes_count, frametimes_cap;
+  FILE* frame_log;
+
+  // Callbacks installed by leif that recorded/replayed events are 
+  // forwarded to
+  GLFWkeyfun lf_keycb;
+  GLFWcharfun lf_charcb;
+  GLFWmousebuttonfun lf_mousebuttoncb;
+  GLFWcursorposfun lf_cursorposcb;
+  GLFWscrollfun lf_scrollcb;
+} input_harness;
+
+typedef enum {
+  FORMAT_CSV = 0,
+  FORMAT_JSONL,
+  FORMAT_TODOTXT
+} exchange_format;
+
+typedef enum {
+  FIELD_IGNORE = 0,
+  FIELD_DESC,
+  FIELD_DONE,
+  FIELD_PRIORITY,
+  FIELD_TAGS,
+  FIELD_DUE,
+  FIELD_DATE,
+  FIELD_DEPTH
+} import_field;
+
+typedef struct {
+  char* data;
+  uint32_t len, cap;
+} exchange_buf;
+
+// Imports are streamed: every record is serialized as soon as it is 
+// parsed, into one temporary file per priority.
+typedef struct {
+  FILE* buckets[PRIORITY_COUNT];
+  tag_table tags;
+  entry_priority root_priority;
+  int64_t depth;
+  uint32_t count, completed, imported, skipped;
+  // Tags that didn't fit into the tag table
+  uint32_t dropped_tags;
+  // Sequence number of the import, it is a single change of the list
+  uint64_t seq;
+  // Date of the import & the converted creation date of the current record
+  char date[32], entry_date[32];
+  // Last converted dates & their results
+  char date_key[32], due_key[32];
+  int64_t due_value;
+} import_ctx;
+
+typedef enum {
+  FONT_JOB_TITLE = 0,
+  FONT_JOB_SMALL,
+  FONT_JOB_THEME,
+  FONT_JOB_COUNT
+} font_job_type;
+
+typedef enum {
+  ICON_BACK = 0,
+  ICON_REMOVE,
+  ICON_RAISE,
+  ICON_COUNT
+} icon_type;
+
+// Fonts create textures while they are loaded, so they are loaded 
+// on the main thread while the workers are running.
+typedef struct {
+  const char* path;
+  uint32_t size;
+  LfFont font;
+  double ms;
+} font_job;
+
+typedef struct {
+  const char* path;
+  int32_t width, height, channels;
+  unsigned char* data;
+} image_job;
+
+// The data file & the icons are loaded by worker threads 
+// while the window is created & the fonts are loaded.
+typedef struct {
+  pthread_t data_thread, image_thread;
+  font_job fonts[FONT_JOB_COUNT];
+  image_job icons[ICON_COUNT];
+  double data_ms, images_ms;
+  // Whether the data worker loaded the list
+  bool data_ok;
+
+  bool stats;
+  double t_start, t_window, t_fonts, t_joined, t_uploaded, t_first_frame;
+} startup_state;
+
 typedef struct {
   GLFWwindow* win;
   int32_t winw, winh;
@@ -49,27 +456,86 @@ typedef struct {
   todo_filter crnt_filter;
   tab crnt_tab;
   entries_da todo_entries;
+  tag_table tags;
+  entry_index index;
+
+  // Sequence number of the last change of the loaded list. Applying 
+  // deltas moves it past the sequence numbers of the other list.
+  uint64_t seq;
+  list_stats stats;
+
+  // Min-heap of upcoming deadlines, ordered by due date. The main 
+  // loop sleeps until the earliest one unless input arrives.
+  entries_da deadlines;
+  uint32_t redraw_frames;
+
+  query_program query;
+  bitmap query_result;
+  bool query_dirty, query_error;
+  char query_src[INPUT_BUF_SIZE];
+  LfInputField query_input;
+  char query_input_buf[INPUT_BUF_SIZE];
 
   LfFont titlefont, smallfont;
 
-  LfInputField new_task_input;
+  LfInputField new_task_input, new_task_tags_input, new_task_due_input;
+  // The task the new task is added as a subtask of (NULL for top level)
+  todo_entry* new_task_parent;
   char new_task_input_buf[INPUT_BUF_SIZE];
+  char new_task_tags_input_buf[INPUT_BUF_SIZE];
+  char new_task_due_input_buf[INPUT_BUF_SIZE];
   LfTexture backicon, removeicon, raiseicon;
 
   FILE* serialization_file;
 
   char tododata_file[128];
+  // Set when the list could not be saved, shown in the top bar
+  bool save_failed;
+
+  // The task whose notes are shown in the dashboard. Only its notes are 
+  // loaded, they are edited in a buffer that grows while typing.
+  todo_entry* notes_entry;
+  exchange_buf notes_buf;
+  LfInputField notes_input;
+
+  todo_list lists[MAX_LISTS];
+  // The active list is the one the GUI opens with, the current list 
+  // is the one that is loaded (which may be picked with --list-name).
+  uint32_t nlists, crnt_list, active_list;
+  const char* requested_list;
+  LfInputField new_list_input;
+  char new_list_input_buf[LIST_NAME_SIZE];
+
+  input_harness input;
+  startup_state startup;
+  mem_gauges mem;
 } state;
 
 static void         resizecb(GLFWwindow* win, int32_t w, int32_t h);
+static void         keycb(GLFWwindow* win, int32_t key, int32_t scancode, int32_t action, int32_t mods);
+static void         charcb(GLFWwindow* win, uint32_t codepoint);
+static void         mousebuttoncb(GLFWwindow* win, int32_t button, int32_t action, int32_t mods);
+static void         cursorposcb(GLFWwindow* win, double xpos, double ypos);
+static void         scrollcb(GLFWwindow* win, double xoffset, double yoffset);
 static void         rendertopbar();
+static void         renderlists();
 static void         renderfilters();
+static void         renderquery();
 static void         renderentries();
+static void         rendernotes();
+static void         renderstats();
 
 static void         initwin();
 static void         initui();
-static void         initentries();
-static void         terminate();
+static bool         initentries();
+static void         initinput();
+static bool         terminate();
+
+static void         start_startup_jobs();
+static void         finish_startup_jobs();
+static void*        data_job(void* arg);
+static void*        image_job_run(void* arg);
+static void         report_startup_stats();
 
 static void         renderdashboard();
 static void         rendernewtask();
@@ -77,32 +543,280 @@ static void         rendernewtask();
 static void         entries_da_init(entries_da* da);
 static void         entries_da_resize(entries_da* da, int32_t new_cap);
 static void         entries_da_push(entries_da* da, todo_entry* entry);  
-static void         entries_da_remove_i(entries_da* da, uint32_t i); 
-static void         entries_da_free(entries_da* da); 
+static void         entries_da_remove_i(entries_da* da, uint32_t i, uint32_t n); 
+static void         entries_da_insert(entries_da* da, uint32_t i, todo_entry* entry); 
+static void         entries_da_free(entries_da* da, bool free_entries); 
+
+static void*        mem_alloc(mem_category category, size_t size);
+static void*        mem_calloc(mem_category category, size_t n, size_t size);
+static void*        mem_realloc(mem_category category, void* ptr, size_t size);
+static char*        mem_strdup(mem_category category, const char* str);
+static void         mem_free(void* ptr);
+static void         mem_count(uint64_t category, int64_t bytes, int64_t count);
+static void         mem_report();
+static bool         mem_report_leaks();
+
+static void         init_tree(entries_da* da);
+static void         update_progress(todo_entry* entry, int32_t dtotal, int32_t ddone);
+static bool         entry_visible(const todo_entry* entry);
+static int32_t      find_entry(const todo_entry* entry);
+static void         insert_entry(todo_entry* entry, todo_entry* parent);
+static uint32_t     remove_entry(uint32_t i);
+static void         raise_entry(uint32_t i);
+static bool         move_entry(todo_entry* entry, todo_entry* parent);
+static void         sort_entry(todo_entry* entry);
+static uint32_t     take_subtree(uint32_t i, todo_entry*** block);
+static void         place_subtree(todo_entry** block, uint32_t n, todo_entry* parent, todo_entry* anchor);
+static uint64_t     next_sibling_id(uint32_t i);
+static void         init_entry(todo_entry* entry);
+static void         free_entry(todo_entry* entry);
+static void         free_list();
+static void         stamp_entry(todo_entry* entry);
+static void         touch_entry(todo_entry* entry, sync_field field);
+static uint64_t     new_entry_id();
+  
+static int32_t      find_tag(tag_table* tags, const char* name);
+static uint64_t     tag_mask(const tag_table* tags);
+static void         drop_unused_tags();
+static int32_t      add_tag(tag_table* tags, const char* name);
+static uint64_t     parse_tags(tag_table* tags, const char* str, bool create, uint32_t* dropped);
+static void         format_tags(tag_table* tags, uint64_t mask, char* buf, size_t size);
+
+static void         bitmap_resize(bitmap* b, uint32_t nbits);
+static void         bitmap_set(bitmap* b, uint32_t i, bool val);
+static void         bitmap_fill(bitmap* b, uint32_t nbits);
+static int64_t      bitmap_next(const bitmap* b, uint32_t from);
+static void         bitmap_and_any(bitmap* dst, bitmap** srcs, uint32_t nsrcs);
+static void         bitmap_free(bitmap* b);
+
+static void         index_invalidate();
+static void         index_rebuild();
+static void         index_update_entry(uint32_t i);
+static bitmap*      index_eval_filter(const todo_filter* filter);
+static void         index_free();
+
+static query_node*  query_parse(const char* src, char* err, size_t errsize);
+static void         query_next_token(query_parser* p);
+static query_node*  query_parse_or(query_parser* p);
+static query_node*  query_parse_and(query_parser* p);
+static query_node*  query_parse_unary(query_parser* p);
+static query_node*  query_parse_primary(query_parser* p);
+static query_node*  query_new_node(query_node_type type, query_node* lhs, query_node* rhs);
+static void         query_free_tree(query_node* node);
+static bool         query_compile(const char* src, tag_table* tags, query_program* prog, char* err, size_t errsize);
+static void         query_emit_node(query_program* prog, query_node* node, tag_table* tags);
+static uint32_t     query_emit(query_program* prog, query_instr instr);
+static void         query_free(query_program* prog);
+static bool         query_eval(const query_program* prog, const todo_entry* entry);
+static bool         query_interpret(const query_node* node, const todo_entry* entry, tag_table* tags);
+static void         set_query(const char* src);
+static int32_t      parse_priority(const char* str);
+static double       bench_now_ms();
+static void         bench_query(const char* src, uint32_t count);
   
+static void         init_deadlines();
+static void         remind_overdue();
+static void         update_deadline(todo_entry* entry);
+static void         deadline_heap_push(todo_entry* entry);
+static void         deadline_heap_remove(todo_entry* entry);
+static void         deadline_heap_swap(uint32_t a, uint32_t b);
+static void         deadline_heap_sift_up(uint32_t i);
+static void         deadline_heap_sift_down(uint32_t i);
+static void         process_deadlines();
+static void         wait_events();
+static void         send_reminder(todo_entry* entry);
+static int64_t      parse_due(const char* str);
+static void         format_due(int64_t due, char* buf, size_t size);
+
 static int          compare_entry_priority(const void* a, const void* b);
 static void         sort_entries_by_priority(entries_da* da);
+static void         sort_siblings(todo_entry** src, uint32_t begin, uint32_t end, todo_entry** dst, uint32_t* out);
 
-static char*        get_command_output(const char* cmd);
+static char*        get_command_output(const char* cmd, mem_category category);
 
 static void         serialize_todo_entry(FILE* file, todo_entry* entry);
-static void         serialize_todo_list(const char* filename, entries_da* da);
-static todo_entry*  deserialize_todo_entry(FILE* file);
-static void         deserialize_todo_list(const char* filename, entries_da* da);
+static bool         serialize_todo_list(const char* filename, entries_da* da, tag_table* tags, uint64_t seq);
+static todo_entry*  deserialize_todo_entry(FILE* file, uint32_t version, bool with_desc);
+static bool         open_todo_list(const char* filename, FILE** file, tag_table* tags, list_header* header);
+static void         deserialize_todo_list(const char* filename, entries_da* da, tag_table* tags, uint64_t* seq);
+static void         write_list_header(FILE* file, uint32_t count, tag_table* tags, uint64_t seq, uint64_t notes_size);
+static bool         copy_bytes(FILE* in, FILE* out, uint64_t size);
+static bool         save_todo_list();
+static void         update_list_counts();
+
+static bool         load_note(const todo_entry* entry, exchange_buf* buf);
+static bool         set_note(todo_entry* entry, const char* text, uint32_t len);
+static bool         compact_notes();
+static bool         replace_list_file(FILE* out, const char* tmppath, bool ok);
+static void         open_notes(todo_entry* entry);
+static void         close_notes();
+static bool         print_notes(uint32_t i);
+
+static void         load_manifest();
+static void         save_manifest();
+static bool         list_data_path(const char* name, char* path, size_t size);
+static int32_t      find_list(const char* name);
+static int32_t      add_list(const char* name);
+static bool         valid_list_name(const char* name);
+static bool         switch_list(uint32_t idx);
+static void         print_lists();
+static bool         select_list();
+
+static int32_t      parse_exchange_format(const char* name, const char* path);
+static import_field map_import_field(const char* name);
+static entry_priority map_priority(const char* str);
+static bool         map_done(const char* str);
+static bool         parse_import_tm(const char* str, bool end_of_day, struct tm* tm);
+static int64_t      import_due(import_ctx* ctx, const char* str);
+static void         exchange_buf_push(exchange_buf* buf, char c);
+static void         exchange_buf_reserve(exchange_buf* buf, uint32_t n);
+static bool         read_line(FILE* file, exchange_buf* buf);
+static void         skip_utf8_bom(FILE* file);
+static int32_t      csv_read_record(FILE* file, exchange_buf* buf, uint32_t* fields, uint32_t maxfields);
+static char*        json_parse_string(char** p);
+static char*        json_parse_value(char** p, char* scratch, size_t size);
+static void         apply_import_field(import_ctx* ctx, todo_entry* entry, import_field field, char* value);
+static void         import_entry(import_ctx* ctx, todo_entry* entry);
+static void         import_record(import_ctx* ctx, todo_entry* entry);
+static void         import_csv(FILE* file, import_ctx* ctx);
+static void         import_jsonl(FILE* file, import_ctx* ctx);
+static void         import_todotxt(FILE* file, import_ctx* ctx);
+static bool         import_todo_list(const char* path, exchange_format format);
+static void         close_import_files(FILE* input, import_ctx* ctx);
+static void         write_csv_field(FILE* file, const char* str, size_t len);
+static void         write_json_string(FILE* file, const char* str, size_t len);
+static void         export_entry(FILE* file, exchange_format format, todo_entry* entry, tag_table* tags);
+static bool         export_todo_list(const char* path, exchange_format format);
+
+static void         data_file_path(const char* suffix, char* path, size_t size);
+static void         append_tombstones(const tombstone* tombstones, uint32_t count);
+static void         id_map_init(id_map* map, uint32_t cap);
+static int64_t      id_map_find(id_map* map, uint64_t id);
+static void         id_map_put(id_map* map, uint64_t id, todo_entry* entry, uint64_t removed);
+static void         id_map_free(id_map* map);
+static void         write_delta_entry(FILE* file, todo_entry* entry, uint64_t parent, tag_table* tags, uint64_t since);
+static bool         export_delta(const char* path, uint64_t since);
+static bool         parse_delta_record(char* line, delta_record* rec);
+static bool         delta_field_wins(const delta_record* rec, const todo_entry* entry, sync_field field);
+static bool         apply_delta_field(const delta_record* rec, todo_entry* entry, sync_field field, todo_entry* parent);
+static bool         apply_delta(const char* path);
+
+static list_op      make_op(op_type type, uint32_t i);
+static void         record_op(list_op* op);
+static void         push_op(const char* suffix, const list_op* op, const char* payload);
+static bool         pop_op(const char* suffix, list_op* op, char** payload);
+static void         trim_op_log(const char* path, long size);
+static void         clear_op_logs();
+static void         clear_op_log(const char* suffix);
+static int32_t      find_op_entry(uint32_t pos, uint64_t id);
+static void         restore_subtree(const list_op* op, char* payload);
+static bool         apply_op(const list_op* op, char* payload, bool undo);
+static bool         undo(bool redo);
+
+static void         stats_add(const char* date, bool completed, entry_priority priority, int32_t sign);
+static void         stats_add_entry(const todo_entry* entry, int32_t sign);
+static void         stats_change(const todo_entry* entry, bool completed, entry_priority priority);
+static void         stats_count_completion(int32_t n);
+static void         stats_history(uint32_t* counts, uint32_t ndays);
+static void         stats_rebuild();
+static bool         read_stats(const char* path, list_stats* stats, uint64_t* seq);
+static void         load_stats();
+static void         save_stats();
+static void         format_stats(char* buf, size_t size);
+static bool         print_stats();
+static int64_t      days_from_civil(int64_t y, uint32_t m, uint32_t d);
+static int64_t      parse_entry_date(const char* date);
+static int64_t      now_minutes();
 
 static void         print_requires_argument(const char* option, uint32_t numargs);
 static void         str_to_lower(char* str);
 
+static bool         is_gui_option(const char* arg);
+static bool         parse_gui_options(int argc, char** argv);
+
+static void         input_events_da_push(input_events_da* da, input_event ev);
+static void         record_input_event(input_event ev);
+static bool         load_input_log(const char* filename);
+static bool         replay_input_frame();
+static void         dispatch_input_event(const input_event* ev);
+static void         push_frame_time(double ms);
+static int          compare_frame_time(const void* a, const void* b);
+static bool         report_frame_timings();
+static uint32_t     xorshift32(uint32_t* state);
+static void         gen_synthetic_entries(entries_da* da, tag_table* tags, uint32_t count, bool tree);
+
 static state s;
 
+// Names of the memory categories in reports
+static const char* mem_category_names[MEM_CATEGORY_COUNT] = {
+  "entries", "descriptions", "dates", "arrays", "other"
+};
+
+// Names of the synced fields in deltas
+static const char* sync_field_names[SYNC_FIELD_COUNT] = {
+  "created", "done", "desc", "priority", "tags", "due", "parent"
+};
+
 void 
 resizecb(GLFWwindow* win, int32_t w, int32_t h) {
+  if(win && s.input.mode == INPUT_REPLAY) return;
+  if(s.input.mode == INPUT_RECORD) {
+    record_input_event((input_event){.type = INPUT_EVENT_RESIZE, .args = {w, h}});
+  }
   s.winw = w;
   s.winh = h;
   lf_resize_display(w, h);
   glViewport(0, 0, w, h);
 }
 
+// The input callbacks below sit in front of the ones leif installs.
+// While recording they log every event with the current frame number, 
+// while replaying they swallow live input so only the log drives the UI.
+void 
+keycb(GLFWwindow* win, int32_t key, int32_t scancode, int32_t action, int32_t mods) {
+  if(s.input.mode == INPUT_REPLAY) return;
+  if(s.input.mode == INPUT_RECORD) {
+    record_input_event((input_event){.type = INPUT_EVENT_KEY, .args = {key, scancode, action, mods}});
+  }
+  if(s.input.lf_keycb) s.input.lf_keycb(win, key, scancode, action, mods);
+}
+
+void 
+charcb(GLFWwindow* win, uint32_t codepoint) {
+  if(s.input.mode == INPUT_REPLAY) return;
+  if(s.input.mode == INPUT_RECORD) {
+    record_input_event((input_event){.type = INPUT_EVENT_CHAR, .args = {(int32_t)codepoint}});
+  }
+  if(s.input.lf_charcb) s.input.lf_charcb(win, codepoint);
+}
+
+void 
+mousebuttoncb(GLFWwindow* win, int32_t button, int32_t action, int32_t mods) {
+  if(s.input.mode == INPUT_REPLAY) return;
+  if(s.input.mode == INPUT_RECORD) {
+    record_input_event((input_event){.type = INPUT_EVENT_MOUSE_BUTTON, .args = {button, action, mods}});
+  }
+  if(s.input.lf_mousebuttoncb) s.input.lf_mousebuttoncb(win, button, action, mods);
+}
+
+void 
+cursorposcb(GLFWwindow* win, double xpos, double ypos) {
+  if(s.input.mode == INPUT_REPLAY) return;
+  if(s.input.mode == INPUT_RECORD) {
+    record_input_event((input_event){.type = INPUT_EVENT_CURSOR_POS, .x = xpos, .y = ypos});
+  }
+  if(s.input.lf_cursorposcb) s.input.lf_cursorposcb(win, xpos, ypos);
+}
+
+void 
+scrollcb(GLFWwindow* win, double xoffset, double yoffset) {
+  if(s.input.mode == INPUT_REPLAY) return;
+  if(s.input.mode == INPUT_RECORD) {
+    record_input_event((input_event){.type = INPUT_EVENT_SCROLL, .x = xoffset, .y = yoffset});
+  }
+  if(s.input.lf_scrollcb) s.input.lf_scrollcb(win, xoffset, yoffset);
+}
+
 void 
 rendertopbar() {
   // Title
@@ -115,6 +829,19 @@ rendertopbar() {
   }
   lf_pop_font();
 
+  // The changes stay in memory until the list can be saved again
+  if(s.save_failed) {
+    LfUIElementProps props = lf_get_theme().text_props;
+    props.text_color = (LfColor){244, 67, 54, 255};
+    props.margin_left = 15.0f;
+    props.margin_top = 12.0f;
+    lf_push_style_props(props);
+    lf_push_font(&s.smallfont);
+    lf_text("Failed to save the list.");
+    lf_pop_font();
+    lf_pop_style_props();
+  }
+
   // Button
   {
     const char* text = "New Task";
@@ -140,13 +867,190 @@ rendertopbar() {
   }
 }
 
+void 
+renderlists() {
+  // UI Properties
+  LfUIElementProps props = lf_get_theme().button_props;
+  props.margin_left = 0.0f;
+  props.margin_right = 10.0f;
+  props.margin_top = 15.0f;
+  props.padding = 8.0f;
+  props.border_width = 0.0f;
+  props.corner_radius = 8.0f;
+  props.text_color = LF_WHITE;
+
+  lf_push_font(&s.smallfont);
+  lf_set_line_should_overflow(false);
+
+  // Rendering a button for every list, the counts come from 
+  // the manifest so the other lists do not need to be loaded.
+  for(uint32_t i = 0; i < s.nlists; i++) {
+    char label[LIST_NAME_SIZE + 16];
+    snprintf(label, sizeof(label), "%s (%u)", s.lists[i].name, s.lists[i].count);
+
+    props.color = (i == s.crnt_list) ? (LfColor){255, 255, 255, 50} : LF_NO_COLOR;
+    lf_push_style_props(props);
+    lf_push_element_id(i);
+    if(lf_button(label) == LF_CLICKED && i != s.crnt_list) {
+      switch_list(i);
+    }
+    lf_pop_element_id();
+    lf_pop_style_props();
+  }
+
+  // Input field to create a new list
+  if(s.input.mode == INPUT_LIVE) {
+    LfUIElementProps inputprops = lf_get_theme().inputfield_props;
+    inputprops.padding = 8.0f;
+    inputprops.margin_top = 15.0f;
+    inputprops.color = BG_COLOR;
+    inputprops.text_color = LF_WHITE;
+    inputprops.border_width = 1.0f;
+    inputprops.border_color = s.new_list_input.selected ? LF_WHITE : (LfColor){170, 170, 170, 255};
+    inputprops.corner_radius = 2.5f;
+    lf_push_style_props(inputprops);
+    lf_input_text(&s.new_list_input);
+    lf_pop_style_props();
+
+    if(s.new_list_input.selected && lf_key_went_down(GLFW_KEY_ENTER) && 
+       strlen(s.new_list_input_buf)) {
+      if(valid_list_name(s.new_list_input_buf)) {
+        int32_t idx = find_list(s.new_list_input_buf);
+        if(idx == -1) {
+          idx = add_list(s.new_list_input_buf);
+        }
+        if(idx != -1) {
+          switch_list(idx);
+        }
+      }
+      memset(s.new_list_input_buf, 0, sizeof(s.new_list_input_buf));
+      s.new_list_input.cursor_index = 0;
+      lf_input_field_unselect_all(&s.new_list_input);
+    }
+  }
+
+  lf_set_line_should_overflow(true);
+  lf_pop_font();
+}
+
+void 
+renderstats() {
+  // Everything shown is maintained on changes, nothing is computed from the entries
+  char summary[256];
+  format_stats(summary, sizeof(summary));
+
+  LfUIElementProps props = lf_get_theme().text_props;
+  props.margin_top = 15.0f;
+  props.text_color = (LfColor){150, 150, 150, 255};
+  lf_push_font(&s.smallfont);
+  lf_push_style_props(props);
+  lf_text(summary);
+  lf_pop_style_props();
+
+  // Completions of the last days as bars, today is on the right
+  uint32_t counts[STATS_SHOWN_DAYS], max = 1;
+  stats_history(counts, STATS_SHOWN_DAYS);
+  for(uint32_t i = 0; i < STATS_SHOWN_DAYS; i++) {
+    if(counts[i] > max) max = counts[i];
+  }
+  const float barw = 6.0f, barh = 15.0f;
+  float ptry_before = lf_get_ptr_y();
+  lf_set_ptr_x_absolute(lf_get_ptr_x() + 15.0f);
+  for(uint32_t i = 0; i < STATS_SHOWN_DAYS; i++) {
+    float h = counts[i] ? barh * counts[i] / max : 1.0f;
+    lf_set_ptr_y_absolute(ptry_before + props.margin_top + barh - h);
+    lf_rect(barw, h, counts[i] ? SECONDARY_COLOR : (LfColor){80, 80, 80, 255}, 1.0f);
+    lf_set_ptr_x_absolute(lf_get_ptr_x() + 2.0f);
+  }
+  lf_set_ptr_y_absolute(ptry_before);
+  lf_pop_font();
+}
+
+void 
+renderquery() {
+  LfUIElementProps props = lf_get_theme().inputfield_props;
+  props.padding = 8.0f;
+  props.margin_top = 20.0f;
+  props.color = BG_COLOR;
+  props.text_color = LF_WHITE;
+  props.border_width = 1.0f;
+  props.corner_radius = 2.5f;
+  if(s.query_error) {
+    props.border_color = (LfColor){244, 67, 54, 255};
+  } else {
+    props.border_color = s.query_input.selected ? LF_WHITE : (LfColor){170, 170, 170, 255};
+  }
+
+  lf_push_font(&s.smallfont);
+  lf_push_style_props(props);
+  lf_set_line_should_overflow(false);
+  lf_input_text(&s.query_input);
+  lf_set_line_should_overflow(true);
+  lf_pop_style_props();
+  lf_pop_font();
+
+  // The query is compiled when it is submitted
+  if(s.query_input.selected && lf_key_went_down(GLFW_KEY_ENTER)) {
+    set_query(s.query_input_buf);
+  }
+}
+
+void 
+rendernotes() {
+  // The buffer always has room for what can be typed in a frame
+  exchange_buf* buf = &s.notes_buf;
+  buf->len = strlen(buf->data);
+  exchange_buf_reserve(buf, NOTES_EDIT_SLACK);
+  s.notes_input.buf = buf->data;
+  s.notes_input.buf_size = buf->cap;
+  s.notes_input.width = s.winw - lf_get_ptr_x() - GLOBAL_MARGIN * 2.0f - 120.0f;
+
+  LfUIElementProps props = lf_get_theme().inputfield_props;
+  props.padding = 8.0f;
+  props.color = BG_COLOR;
+  props.text_color = LF_WHITE;
+  props.border_width = 1.0f;
+  props.corner_radius = 2.5f;
+  props.border_color = s.notes_input.selected ? LF_WHITE : (LfColor){170, 170, 170, 255};
+  lf_push_font(&s.smallfont);
+  lf_push_style_props(props);
+  lf_input_text(&s.notes_input);
+  lf_pop_style_props();
+
+  LfUIElementProps btnprops = lf_get_theme().button_props;
+  btnprops.color = LF_NO_COLOR;
+  btnprops.text_color = (LfColor){150, 150, 150, 255};
+  btnprops.border_width = 0.0f; btnprops.padding = 0.0f; 
+  btnprops.margin_top = 8.0f; btnprops.margin_left = 10.0f;
+  lf_push_style_props(btnprops);
+  if(lf_button("Save") == LF_CLICKED) {
+    set_note(s.notes_entry, buf->data, strlen(buf->data));
+  }
+  if(lf_button("Close") == LF_CLICKED) {
+    close_notes();
+  }
+  lf_pop_style_props();
+  lf_pop_font();
+}
+
 void 
 renderfilters() {
-  // Filters 
-  uint32_t itemcount = 6;
-  static const char* items[] = {
-    "ALL", "IN PROGRESS", "COMPLETED", "LOW", "MEDIUM", "HIGH"
+  // Filters, followed by one filter for every tag of the list
+  static const char* fixed_items[] = {
+    "ALL", "IN PROGRESS", "COMPLETED", "LOW", "MEDIUM", "HIGH", "OVERDUE"
   };
+  const uint32_t nfixed = sizeof(fixed_items) / sizeof(fixed_items[0]);
+  uint32_t itemcount = nfixed + s.tags.count;
+
+  static char tag_items[MAX_TAGS][TAG_NAME_SIZE + 1];
+  const char* items[sizeof(fixed_items) / sizeof(fixed_items[0]) + MAX_TAGS];
+  for(uint32_t i = 0; i < nfixed; i++) {
+    items[i] = fixed_items[i];
+  }
+  for(uint32_t i = 0; i < s.tags.count; i++) {
+    snprintf(tag_items[i], sizeof(tag_items[i]), "#%s", s.tags.names[i]);
+    items[nfixed + i] = tag_items[i];
+  }
 
   // UI Properties
   LfUIElementProps props = lf_get_theme().button_props;
@@ -170,6 +1074,7 @@ renderfilters() {
     lf_set_cull_end_y(s.winh);
     lf_set_no_render(true);
     for(uint32_t i = 0; i < itemcount; i++) {
+      if(i >= nfixed && !s.tags.names[i - nfixed][0]) continue;
       lf_button(items[i]);
     }
     lf_unset_cull_end_x();
@@ -183,9 +1088,27 @@ renderfilters() {
   // Rendering the filter items
   lf_set_line_should_overflow(false);
   for(uint32_t i = 0; i < itemcount; i++) {
+    // Dropped tags leave empty slots, they have no filter
+    if(i >= nfixed && !s.tags.names[i - nfixed][0]) continue;
+    // Every item except ALL toggles its bit in the filter, 
+    // ALL resets the filter.
+    todo_filter* filter = &s.crnt_filter;
+    bool selected;
+    if(i == 0) {
+      selected = !filter->states && !filter->priorities && !filter->tags && !filter->overdue;
+    } else if(i <= 2) {
+      selected = filter->states & (1 << (i - 1));
+    } else if(i < nfixed - 1) {
+      selected = filter->priorities & (1 << (i - 3));
+    } else if(i == nfixed - 1) {
+      selected = filter->overdue;
+    } else {
+      selected = filter->tags & (1ULL << (i - nfixed));
+    }
+
     // If the filter is currently selected, render a 
     // box around it to indicate selection.
-    if(s.crnt_filter == (uint32_t)i) {
+    if(selected) {
       props.color = (LfColor){255, 255, 255, 50};
     } else {
       props.color = LF_NO_COLOR;
@@ -193,7 +1116,17 @@ renderfilters() {
     // Rendering the button
     lf_push_style_props(props);
     if(lf_button(items[i]) == LF_CLICKED) {
-      s.crnt_filter = i;
+      if(i == 0) {
+        memset(filter, 0, sizeof(*filter));
+      } else if(i <= 2) {
+        filter->states ^= (1 << (i - 1));
+      } else if(i < nfixed - 1) {
+        filter->priorities ^= (1 << (i - 3));
+      } else if(i == nfixed - 1) {
+        filter->overdue = !filter->overdue;
+      } else {
+        filter->tags ^= (1ULL << (i - nfixed));
+      }
     }
     lf_pop_style_props();
   }
@@ -209,15 +1142,25 @@ renderentries() {
                ((vec2s){(s.winw - lf_get_ptr_x()) - GLOBAL_MARGIN, (s.winh - lf_get_ptr_y()) - GLOBAL_MARGIN}), 
                true);
 
+  // Changes to the order of the list are applied 
+  // after iterating, so the filter result stays valid.
+  int32_t remove_idx = -1, raise_idx = -1, collapse_idx = -1;
+  todo_entry* notes_toggle = NULL;
+  bool resort = false;
+  // Priority changes are logged once the entry is sorted into place
+  list_op priority_op;
+
+  // Filtering the entries
+  bitmap* matches = index_eval_filter(&s.crnt_filter);
+
+  // The subtasks of collapsed entries are jumped over 
+  uint32_t skip = 0;
   uint32_t renderedcount = 0;
-  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+  for(int64_t i = bitmap_next(matches, 0); i != -1; i = bitmap_next(matches, i + 1 + skip)) {
     todo_entry* entry = s.todo_entries.entries[i];
-    // Filtering the entries
-    if(s.crnt_filter == FILTER_COMPLETED && !entry->completed) continue;
-    if(s.crnt_filter == FILTER_IN_PROGRESS && entry->completed) continue;
-    if(s.crnt_filter == FILTER_LOW && entry->priority != PRIORITY_LOW) continue;
-    if(s.crnt_filter == FILTER_MEDIUM && entry->priority != PRIORITY_MEDIUM) continue;
-    if(s.crnt_filter == FILTER_HIGH && entry->priority != PRIORITY_HIGH) continue;
+    skip = entry->collapsed ? entry->nsubtasks : 0;
+
+    lf_set_ptr_x_absolute(lf_get_ptr_x() + entry->depth * SUBTASK_INDENT);
 
     {
       float ptry_before = lf_get_ptr_y();
@@ -227,12 +1170,17 @@ renderentries() {
       bool clicked_priority = lf_hovered((vec2s){lf_get_ptr_x(), lf_get_ptr_y()}, (vec2s){priority_size, priority_size}) &&
                               lf_mouse_button_went_down(GLFW_MOUSE_BUTTON_LEFT);
       if(clicked_priority) {
+        priority_op = make_op(OP_PRIORITY, i);
+        priority_op.before = entry->priority;
         if(entry->priority + 1 >= PRIORITY_COUNT) {
           entry->priority = 0;
         } else {
           entry->priority++;
         }
-        sort_entries_by_priority(&s.todo_entries);
+        priority_op.after = entry->priority;
+        stats_change(entry, entry->completed, (entry_priority)priority_op.before);
+        touch_entry(entry, SYNC_PRIORITY);
+        resort = true;
       }
       switch (entry->priority) {
         case PRIORITY_LOW: {
@@ -258,8 +1206,7 @@ renderentries() {
       props.border_width = 0.0f; props.padding = 0.0f; props.margin_top = 13; props.margin_left = 10.0f;
       lf_push_style_props(props);
       if(lf_image_button(((LfTexture){.id = s.removeicon.id, .width = 20, .height = 20})) == LF_CLICKED) {
-        entries_da_remove_i(&s.todo_entries, i);
-        serialize_todo_list(s.tododata_file, &s.todo_entries);
+        remove_idx = i;
       }
       lf_pop_style_props();
     }
@@ -269,7 +1216,16 @@ renderentries() {
       props.color = BG_COLOR;
       lf_push_style_props(props);
       if(lf_checkbox("", &entry->completed, LF_NO_COLOR, SECONDARY_COLOR) == LF_CLICKED) {
-        serialize_todo_list(s.tododata_file, &s.todo_entries);
+        list_op op = make_op(OP_TOGGLE, i);
+        op.before = !entry->completed;
+        op.after = entry->completed;
+        record_op(&op);
+        update_progress(entry, 0, entry->completed ? 1 : -1);
+        stats_change(entry, !entry->completed, entry->priority);
+        touch_entry(entry, SYNC_DONE);
+        update_deadline(entry);
+        index_update_entry(i);
+        save_todo_list();
       }
       lf_pop_style_props();
     }
@@ -277,6 +1233,19 @@ renderentries() {
     float textptrx = lf_get_ptr_x();
     lf_text(entry->desc);
 
+    // Expanding/collapsing the subtasks of the entry
+    if(entry->nsubtasks) {
+      LfUIElementProps props = lf_get_theme().button_props;
+      props.color = LF_NO_COLOR;
+      props.text_color = (LfColor){150, 150, 150, 255};
+      props.border_width = 0.0f; props.padding = 0.0f; props.margin_left = 10.0f;
+      lf_push_style_props(props);
+      if(lf_button(entry->collapsed ? "[+]" : "[-]") == LF_CLICKED) {
+        collapse_idx = i;
+      }
+      lf_pop_style_props();
+    }
+
     lf_set_ptr_x_absolute(textptrx);
     lf_set_ptr_y_absolute(lf_get_ptr_y() + lf_get_theme().font.font_size);
     {
@@ -286,6 +1255,52 @@ renderentries() {
       lf_push_style_props(props);
       lf_push_font(&s.smallfont);
       lf_text(entry->date);
+      if(entry->due) {
+        char duebuf[64], due_date[32];
+        format_due(entry->due, due_date, sizeof(due_date));
+        snprintf(duebuf, sizeof(duebuf), "%s %s", entry->overdue ? "overdue since" : "due", due_date);
+        LfUIElementProps dueprops = props;
+        dueprops.text_color = entry->overdue ? (LfColor){244, 67, 54, 255} : (LfColor){150, 150, 150, 255};
+        dueprops.margin_left = 10.0f;
+        lf_push_style_props(dueprops);
+        lf_text(duebuf);
+        lf_pop_style_props();
+      }
+      if(entry->tags) {
+        char tagsbuf[INPUT_BUF_SIZE];
+        format_tags(&s.tags, entry->tags, tagsbuf, sizeof(tagsbuf));
+        props.text_color = SECONDARY_COLOR;
+        props.margin_left = 10.0f;
+        lf_push_style_props(props);
+        lf_text(tagsbuf);
+        lf_pop_style_props();
+      }
+      if(entry->nsubtasks) {
+        char progressbuf[64];
+        snprintf(progressbuf, sizeof(progressbuf), "%u/%u subtasks done", 
+                 entry->nsubtasks_done, entry->nsubtasks);
+        LfUIElementProps progressprops = props;
+        progressprops.margin_left = 10.0f;
+        lf_push_style_props(progressprops);
+        lf_text(progressbuf);
+        lf_pop_style_props();
+      }
+      {
+        LfUIElementProps subprops = lf_get_theme().button_props;
+        subprops.color = LF_NO_COLOR;
+        subprops.text_color = (LfColor){150, 150, 150, 255};
+        subprops.border_width = 0.0f; subprops.padding = 0.0f; 
+        subprops.margin_top = 2.5f; subprops.margin_left = 10.0f;
+        lf_push_style_props(subprops);
+        if(lf_button("+ subtask") == LF_CLICKED) {
+          s.new_task_parent = entry;
+          s.crnt_tab = TAB_NEW_TASK;
+        }
+        if(lf_button(entry == s.notes_entry ? "- notes" : (entry->note_size ? "notes" : "+ notes")) == LF_CLICKED) {
+          notes_toggle = entry;
+        }
+        lf_pop_style_props();
+      }
       lf_pop_font();
       lf_pop_style_props();
     }
@@ -301,10 +1316,7 @@ renderentries() {
       lf_push_style_props(props);
       lf_set_image_color((LfColor){120, 120, 120, 255});
       if(lf_image_button(((LfTexture){.id = s.raiseicon.id, .width = texw, .height = texh})) == LF_CLICKED) {
-        todo_entry* tmp = s.todo_entries.entries[0];
-        s.todo_entries.entries[0] = entry;
-        s.todo_entries.entries[i] = tmp;
-        serialize_todo_list(s.tododata_file, &s.todo_entries);
+        raise_idx = i;
       }
       lf_unset_image_color();
       lf_set_line_should_overflow(true);
@@ -312,6 +1324,12 @@ renderentries() {
     }
 
     lf_next_line();
+    // The notes of the expanded task are shown below it
+    if(entry == s.notes_entry) {
+      lf_set_ptr_x_absolute(textptrx);
+      rendernotes();
+      lf_next_line();
+    }
     renderedcount++;
   }
   if(!renderedcount) {
@@ -319,6 +1337,40 @@ renderentries() {
   }
 
   lf_div_end();
+
+  if(notes_toggle == s.notes_entry) {
+    close_notes();
+  } else if(notes_toggle) {
+    open_notes(notes_toggle);
+  }
+
+  if(remove_idx != -1) {
+    list_op op = make_op(OP_REMOVE, remove_idx);
+    record_op(&op);
+    remove_entry(remove_idx);
+    index_invalidate();
+    save_todo_list();
+  } else if(raise_idx != -1) {
+    list_op op = make_op(OP_REORDER, raise_idx);
+    todo_entry* entry = s.todo_entries.entries[raise_idx];
+    raise_entry(raise_idx);
+    op.pos = find_entry(entry);
+    record_op(&op);
+    index_invalidate();
+    save_todo_list();
+  } else if(collapse_idx != -1) {
+    todo_entry* entry = s.todo_entries.entries[collapse_idx];
+    entry->collapsed = !entry->collapsed;
+    index_invalidate();
+    save_todo_list();
+  } else if(resort) {
+    todo_entry* entry = s.todo_entries.entries[priority_op.pos];
+    sort_entries_by_priority(&s.todo_entries);
+    priority_op.pos = find_entry(entry);
+    record_op(&priority_op);
+    index_invalidate();
+    save_todo_list();
+  }
 }
 
 void 
@@ -335,21 +1387,42 @@ initwin() {
   glfwMakeContextCurrent(s.win);
   glfwSetFramebufferSizeCallback(s.win, resizecb);
   lf_init_glfw(s.winw, s.winh, s.win);
+  initinput();
+}
+
+void 
+initinput() {
+  // Installing our input callbacks in front of leif's. GLFW hands back 
+  // the previously set callback which is where the events are forwarded to.
+  s.input.lf_keycb = glfwSetKeyCallback(s.win, keycb);
+  s.input.lf_charcb = glfwSetCharCallback(s.win, charcb);
+  s.input.lf_mousebuttoncb = glfwSetMouseButtonCallback(s.win, mousebuttoncb);
+  s.input.lf_cursorposcb = glfwSetCursorPosCallback(s.win, cursorposcb);
+  s.input.lf_scrollcb = glfwSetScrollCallback(s.win, scrollcb);
+
+  // Rendering frames as fast as possible while replaying, 
+  // vsync would hide frame time regressions.
+  if(s.input.mode == INPUT_REPLAY) {
+    glfwSwapInterval(0);
+  }
 }
 
 void 
 initui() {
+  // Uploading the fonts & icons the workers loaded
+  finish_startup_jobs();
+
   // Initializing fonts
-  s.titlefont = lf_load_font(FONT_BOLD, 40);
-  s.smallfont = lf_load_font(FONT, 20);
+  s.titlefont = s.startup.fonts[FONT_JOB_TITLE].font;
+  s.smallfont = s.startup.fonts[FONT_JOB_SMALL].font;
 
-  s.crnt_filter = FILTER_ALL;
+  memset(&s.crnt_filter, 0, sizeof(s.crnt_filter));
 
   // Initializing base theme
   LfTheme theme = lf_get_theme();
   theme.div_props.color = LF_NO_COLOR;
   lf_free_font(&theme.font);
-  theme.font = lf_load_font(FONT, 24);
+  theme.font = s.startup.fonts[FONT_JOB_THEME].font;
   theme.scrollbar_props.corner_radius = 2;
   theme.scrollbar_props.color = lf_color_brightness(BG_COLOR, 3.0);
   theme.div_smooth_scroll = SMOOTH_SCROLL;
@@ -364,23 +1437,171 @@ initui() {
     .placeholder = (char*)"What is there to do?"
   };
 
-  s.backicon = lf_load_texture(BACK_ICON, true, LF_TEX_FILTER_LINEAR);
-  s.removeicon = lf_load_texture(REMOVE_ICON, true, LF_TEX_FILTER_LINEAR);
-  s.raiseicon = lf_load_texture(RAISE_ICON, true, LF_TEX_FILTER_LINEAR);
-  initentries();
-}
-
-void 
-initentries() {
-  strcat(s.tododata_file, TODO_DATA_DIR);
-  strcat(s.tododata_file, "/");
-  strcat(s.tododata_file, TODO_DATA_FILE);
+  memset(s.new_task_tags_input_buf, 0, INPUT_BUF_SIZE);
+  s.new_task_tags_input = (LfInputField){
+    .width = 400,
+    .buf = s.new_task_tags_input_buf,
+    .buf_size = INPUT_BUF_SIZE,
+    .placeholder = (char*)"e.g. infra, oncall"
+  };
 
-  entries_da_init(&s.todo_entries);
-  deserialize_todo_list(s.tododata_file, &s.todo_entries);
-}
+  memset(s.new_task_due_input_buf, 0, INPUT_BUF_SIZE);
+  s.new_task_due_input = (LfInputField){
+    .width = 400,
+    .buf = s.new_task_due_input_buf,
+    .buf_size = INPUT_BUF_SIZE,
+    .placeholder = (char*)"e.g. 24.12.2024 18:00"
+  };
+
+  memset(s.query_input_buf, 0, INPUT_BUF_SIZE);
+  s.query_input = (LfInputField){
+    .width = 300,
+    .buf = s.query_input_buf,
+    .buf_size = INPUT_BUF_SIZE,
+    .placeholder = (char*)"Query, e.g. priority>=medium and !done"
+  };
+
+  memset(s.new_list_input_buf, 0, LIST_NAME_SIZE);
+  s.new_list_input = (LfInputField){
+    .width = 150,
+    .buf = s.new_list_input_buf,
+    .buf_size = LIST_NAME_SIZE,
+    .placeholder = (char*)"New list"
+  };
+
+  // The buffer of the notes input is set when notes are opened
+  s.notes_input = (LfInputField){
+    .width = 400,
+    .placeholder = (char*)"Notes"
+  };
+
+}
+
+void 
+start_startup_jobs() {
+  startup_state* st = &s.startup;
+  st->t_start = bench_now_ms();
+
+  static const char* icons[ICON_COUNT] = { BACK_ICON, REMOVE_ICON, RAISE_ICON };
+  for(uint32_t i = 0; i < ICON_COUNT; i++) {
+    st->icons[i] = (image_job){.path = icons[i]};
+  }
+  st->fonts[FONT_JOB_TITLE] = (font_job){.path = FONT_BOLD, .size = 40};
+  st->fonts[FONT_JOB_SMALL] = (font_job){.path = FONT, .size = 20};
+  st->fonts[FONT_JOB_THEME] = (font_job){.path = FONT, .size = 24};
+
+  pthread_create(&st->data_thread, NULL, data_job, NULL);
+  pthread_create(&st->image_thread, NULL, image_job_run, NULL);
+}
 
 void 
+finish_startup_jobs() {
+  startup_state* st = &s.startup;
+  // The fonts are loaded while the workers are still running
+  for(uint32_t i = 0; i < FONT_JOB_COUNT; i++) {
+    font_job* job = &st->fonts[i];
+    double start = bench_now_ms();
+    job->font = lf_load_font(job->path, job->size);
+    job->ms = bench_now_ms() - start;
+  }
+  st->t_fonts = bench_now_ms();
+
+  pthread_join(st->data_thread, NULL);
+  pthread_join(st->image_thread, NULL);
+  st->t_joined = bench_now_ms();
+
+  // GL objects can only be created on the main thread. Anything 
+  // the worker failed to load is loaded the usual way.
+  LfTexture* icons[ICON_COUNT] = { &s.backicon, &s.removeicon, &s.raiseicon };
+  for(uint32_t i = 0; i < ICON_COUNT; i++) {
+    image_job* job = &st->icons[i];
+    if(job->data) {
+      *icons[i] = (LfTexture){.width = job->width, .height = job->height};
+      lf_create_texture_from_image_data(LF_TEX_FILTER_LINEAR, &icons[i]->id, 
+                                        job->width, job->height, job->channels, job->data);
+      free(job->data);
+      job->data = NULL;
+    } else {
+      *icons[i] = lf_load_texture(job->path, true, LF_TEX_FILTER_LINEAR);
+    }
+  }
+  st->t_uploaded = bench_now_ms();
+}
+
+void* 
+data_job(void* arg) {
+  (void)arg;
+  // Failures are reported to the main thread, which exits once it 
+  // joined the workers instead of exiting in the middle of GLFW calls.
+  double start = bench_now_ms();
+  s.startup.data_ok = initentries();
+  s.startup.data_ms = bench_now_ms() - start;
+  return NULL;
+}
+
+void* 
+image_job_run(void* arg) {
+  (void)arg;
+  double start = bench_now_ms();
+  for(uint32_t i = 0; i < ICON_COUNT; i++) {
+    image_job* job = &s.startup.icons[i];
+    job->data = lf_load_texture_data(job->path, &job->width, &job->height, &job->channels, true);
+  }
+  s.startup.images_ms = bench_now_ms() - start;
+  return NULL;
+}
+
+void 
+report_startup_stats() {
+  startup_state* st = &s.startup;
+  printf("======== Startup ========\n");
+  printf("window creation:      %8.2f ms\n", st->t_window - st->t_start);
+  printf("data file (worker):   %8.2f ms (%u tasks)\n", st->data_ms, s.todo_entries.count);
+  printf("icons (worker):       %8.2f ms\n", st->images_ms);
+  printf("fonts (main thread):  %8.2f ms\n", st->t_fonts - st->t_window);
+  for(uint32_t i = 0; i < FONT_JOB_COUNT; i++) {
+    font_job* job = &st->fonts[i];
+    printf("  font %-2u:            %8.2f ms (%s, %upx)\n", i, job->ms, job->path, job->size);
+  }
+  printf("waiting for workers:  %8.2f ms\n", st->t_joined - st->t_fonts);
+  printf("texture upload:       %8.2f ms\n", st->t_uploaded - st->t_joined);
+  printf("first frame:          %8.2f ms\n", st->t_first_frame - st->t_uploaded);
+  printf("time to first frame:  %8.2f ms\n", st->t_first_frame - st->t_start);
+  printf("=========================\n");
+}
+
+bool 
+initentries() {
+  // Input recordings are made & replayed against a fixed synthetic data set 
+  // that lives in a scratch file, so the users list is never touched.
+  if(s.input.mode != INPUT_LIVE) {
+    strcat(s.tododata_file, REPLAY_DATA_FILE);
+    strcpy(s.lists[0].name, "synthetic");
+    s.nlists = 1;
+    entries_da_init(&s.todo_entries);
+    gen_synthetic_entries(&s.todo_entries, &s.tags, s.input.synthetic_count, s.input.synthetic_tree);
+    memset(&s.stats, 0, sizeof(s.stats));
+    stats_rebuild();
+    init_deadlines();
+    bool ok = save_todo_list();
+    clear_op_logs();
+    return ok;
+  }
+
+  if(!select_list()) {
+    return false;
+  }
+
+  // Only the active list is deserialized
+  entries_da_init(&s.todo_entries);
+  deserialize_todo_list(s.tododata_file, &s.todo_entries, &s.tags, &s.seq);
+  load_stats();
+  init_deadlines();
+  index_invalidate();
+  return true;
+}
+
+bool 
 terminate() {
   // Terminate UI library
   lf_terminate();
@@ -388,16 +1609,44 @@ terminate() {
   // Freeing allocated resources
   lf_free_font(&s.smallfont);
   lf_free_font(&s.titlefont);
-  entries_da_free(&s.todo_entries); 
+  free_list();
+
+  // Finishing the input log
+  if(s.input.log) {
+    fprintf(s.input.log, "end %lu\n", (unsigned long)s.input.frame);
+    fclose(s.input.log);
+  }
+  if(s.input.frame_log) {
+    fclose(s.input.frame_log);
+  }
+  mem_free(s.input.events.events);
+  mem_free(s.input.frametimes);
 
   // Terminate Windowing
   glfwDestroyWindow(s.win);
   glfwTerminate();
+
+  // Everything todo allocated has to be freed by now
+  return !mem_report_leaks();
 }
 void 
 renderdashboard() {
+  // Ctrl+Z undoes the last change, Ctrl+Shift+Z redoes it
+  if(!s.query_input.selected && !s.new_list_input.selected && !s.notes_input.selected && 
+     (lf_key_is_down(GLFW_KEY_LEFT_CONTROL) || lf_key_is_down(GLFW_KEY_RIGHT_CONTROL)) && 
+     lf_key_went_down(GLFW_KEY_Z)) {
+    bool redo = lf_key_is_down(GLFW_KEY_LEFT_SHIFT) || lf_key_is_down(GLFW_KEY_RIGHT_SHIFT);
+    if(undo(redo)) {
+      index_invalidate();
+    }
+  }
   rendertopbar();
   lf_next_line();
+  renderlists();
+  lf_next_line();
+  renderstats();
+  lf_next_line();
+  renderquery();
   renderfilters();
   lf_next_line();
   renderentries();
@@ -411,11 +1660,25 @@ rendernewtask() {
     LfUIElementProps props = lf_get_theme().text_props;
     props.margin_bottom = 15.0f;
     lf_push_style_props(props);
-    lf_text("Add a new Task");
+    lf_text(s.new_task_parent ? "Add a new Subtask" : "Add a new Task");
     lf_pop_style_props();
     lf_pop_font();
   }
 
+  if(s.new_task_parent) {
+    lf_next_line();
+    char parentbuf[INPUT_BUF_SIZE + 16];
+    snprintf(parentbuf, sizeof(parentbuf), "Subtask of '%s'", s.new_task_parent->desc);
+    LfUIElementProps props = lf_get_theme().text_props;
+    props.text_color = (LfColor){150, 150, 150, 255};
+    props.margin_bottom = 15.0f;
+    lf_push_style_props(props);
+    lf_push_font(&s.smallfont);
+    lf_text(parentbuf);
+    lf_pop_font();
+    lf_pop_style_props();
+  }
+
   lf_next_line();
 
   // Description input field 
@@ -442,6 +1705,56 @@ rendernewtask() {
 
   lf_next_line();
 
+  // Tags input field 
+  {
+    lf_push_font(&s.smallfont);
+    lf_text("Tags (comma separated)");
+    lf_pop_font();
+
+    lf_next_line();
+    LfUIElementProps props = lf_get_theme().inputfield_props;
+    props.padding = 15;
+    props.color = BG_COLOR;
+    props.text_color = LF_WHITE;
+    props.border_width = 1.0f;
+    props.border_color = s.new_task_tags_input.selected ? LF_WHITE : (LfColor){170, 170, 170, 255};
+    props.corner_radius = 2.5f;
+    props.margin_bottom = 10.0f;
+    lf_push_style_props(props);
+    lf_input_text(&s.new_task_tags_input);
+    lf_pop_style_props();
+  }
+
+  lf_next_line();
+
+  // Due date input field 
+  bool due_valid = true;
+  {
+    lf_push_font(&s.smallfont);
+    lf_text("Due (DD.MM.YYYY HH:MM, optional)");
+    lf_pop_font();
+
+    lf_next_line();
+    due_valid = !strlen(s.new_task_due_input_buf) || parse_due(s.new_task_due_input_buf) != -1;
+    LfUIElementProps props = lf_get_theme().inputfield_props;
+    props.padding = 15;
+    props.color = BG_COLOR;
+    props.text_color = LF_WHITE;
+    props.border_width = 1.0f;
+    if(!due_valid) {
+      props.border_color = (LfColor){244, 67, 54, 255};
+    } else {
+      props.border_color = s.new_task_due_input.selected ? LF_WHITE : (LfColor){170, 170, 170, 255};
+    }
+    props.corner_radius = 2.5f;
+    props.margin_bottom = 10.0f;
+    lf_push_style_props(props);
+    lf_input_text(&s.new_task_due_input);
+    lf_pop_style_props();
+  }
+
+  lf_next_line();
+
   lf_next_line();
 
   // Priority dropdown
@@ -470,7 +1783,7 @@ rendernewtask() {
 
   // Add Button
   {
-    bool form_complete = (strlen(s.new_task_input_buf) && selected_priority != -1);
+    bool form_complete = (strlen(s.new_task_input_buf) && selected_priority != -1 && due_valid);
     const char* text = "Add";
     const float width = 150.0f;
 
@@ -490,25 +1803,38 @@ rendernewtask() {
       (lf_key_went_down(GLFW_KEY_ENTER) && form_complete)) {
 
       // Copy the description input buffers content to a new pointer
-      char* desc = malloc(strlen(s.new_task_input_buf));
-      strcpy(desc, s.new_task_input_buf);
+      char* desc = mem_strdup(MEM_DESCRIPTIONS, s.new_task_input_buf);
 
       // Allocate a new entry
-      todo_entry* entry = malloc(sizeof(todo_entry));
+      todo_entry* entry = mem_alloc(MEM_ENTRIES, sizeof(todo_entry));
+      init_entry(entry);
       entry->desc = desc;
-      entry->date = get_command_output(DATE_CMD);
+      entry->date = get_command_output(DATE_CMD, MEM_DATES);
       entry->completed = false;
       entry->priority = (entry_priority)selected_priority;
-      entries_da_push(&s.todo_entries, entry);
+      entry->tags = parse_tags(&s.tags, s.new_task_tags_input_buf, true, NULL);
+      entry->due = strlen(s.new_task_due_input_buf) ? parse_due(s.new_task_due_input_buf) : 0;
+      update_deadline(entry);
+      insert_entry(entry, s.new_task_parent);
+      s.new_task_parent = NULL;
       sort_entries_by_priority(&s.todo_entries);
+      list_op op = make_op(OP_ADD, find_entry(entry));
+      record_op(&op);
+      index_invalidate();
 
       // Serialize entries 
-      serialize_todo_list(s.tododata_file, &s.todo_entries);
+      save_todo_list();
 
       // Reset interface state
       memset(s.new_task_input_buf, 0, sizeof(s.new_task_input_buf));
+      memset(s.new_task_tags_input_buf, 0, sizeof(s.new_task_tags_input_buf));
+      memset(s.new_task_due_input_buf, 0, sizeof(s.new_task_due_input_buf));
       s.new_task_input.cursor_index = 0;
+      s.new_task_tags_input.cursor_index = 0;
+      s.new_task_due_input.cursor_index = 0;
       lf_input_field_unselect_all(&s.new_task_input);
+      lf_input_field_unselect_all(&s.new_task_tags_input);
+      lf_input_field_unselect_all(&s.new_task_due_input);
     }
     lf_set_line_should_overflow(true);
     lf_pop_style_props();
@@ -533,16 +1859,111 @@ rendernewtask() {
 
     if(lf_image_button(backbutton) == LF_CLICKED) {
       s.crnt_tab = TAB_DASHBOARD;
+      s.new_task_parent = NULL;
     }
     lf_set_line_should_overflow(true);
     lf_pop_style_props();
   }
 }
+void* 
+mem_alloc(mem_category category, size_t size) {
+  mem_header* header = malloc(sizeof(mem_header) + size);
+  if(!header) return NULL;
+  header->size = size;
+  header->category = category;
+  mem_count(category, (int64_t)size, 1);
+  return header + 1;
+}
+
+void* 
+mem_calloc(mem_category category, size_t n, size_t size) {
+  void* ptr = mem_alloc(category, n * size);
+  if(ptr) memset(ptr, 0, n * size);
+  return ptr;
+}
+
+void* 
+mem_realloc(mem_category category, void* ptr, size_t size) {
+  if(!ptr) return mem_alloc(category, size);
+  mem_header* header = (mem_header*)ptr - 1;
+  uint64_t old_size = header->size;
+  header = realloc(header, sizeof(mem_header) + size);
+  if(!header) return NULL;
+  header->size = size;
+  mem_count(header->category, (int64_t)size - (int64_t)old_size, 0);
+  return header + 1;
+}
+
+char* 
+mem_strdup(mem_category category, const char* str) {
+  size_t len = strlen(str) + 1;
+  char* copy = mem_alloc(category, len);
+  if(copy) memcpy(copy, str, len);
+  return copy;
+}
+
+void 
+mem_free(void* ptr) {
+  if(!ptr) return;
+  mem_header* header = (mem_header*)ptr - 1;
+  mem_count(header->category, -(int64_t)header->size, -1);
+  free(header);
+}
+
+void 
+mem_count(uint64_t category, int64_t bytes, int64_t count) {
+  mem_gauges* mem = &s.mem;
+  __atomic_add_fetch(&mem->bytes[category], bytes, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&mem->count[category], count, __ATOMIC_RELAXED);
+  int64_t total = __atomic_add_fetch(&mem->total, bytes, __ATOMIC_RELAXED);
+  int64_t peak = __atomic_load_n(&mem->peak, __ATOMIC_RELAXED);
+  while(total > peak && 
+        !__atomic_compare_exchange_n(&mem->peak, &peak, total, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void 
+mem_report() {
+  mem_gauges* mem = &s.mem;
+  int64_t count = 0;
+  printf("======== Memory ========\n");
+  for(uint32_t i = 0; i < MEM_CATEGORY_COUNT; i++) {
+    printf("%-13s %10.1f KB in %lld allocations\n", mem_category_names[i], 
+           mem->bytes[i] / 1024.0, (long long)mem->count[i]);
+    count += mem->count[i];
+  }
+  printf("total:        %10.1f KB in %lld allocations (%.1f KB of headers)\n", 
+         mem->total / 1024.0, (long long)count, count * sizeof(mem_header) / 1024.0);
+  printf("peak:         %10.1f KB\n", mem->peak / 1024.0);
+  if(s.todo_entries.count) {
+    printf("per task:     %10.1f bytes\n", (double)mem->total / s.todo_entries.count);
+  }
+  printf("========================\n");
+}
+
+bool 
+mem_report_leaks() {
+  // Reports what is still allocated, returns whether there is anything
+  mem_gauges* mem = &s.mem;
+  int64_t count = 0;
+  for(uint32_t i = 0; i < MEM_CATEGORY_COUNT; i++) {
+    count += mem->count[i];
+  }
+  if(!count) return false;
+  fprintf(stderr, "todo: %lld bytes in %lld allocations were not freed:\n", 
+          (long long)mem->total, (long long)count);
+  for(uint32_t i = 0; i < MEM_CATEGORY_COUNT; i++) {
+    if(!mem->count[i]) continue;
+    fprintf(stderr, "todo:   %s: %lld bytes in %lld allocations\n", mem_category_names[i], 
+            (long long)mem->bytes[i], (long long)mem->count[i]);
+  }
+  return true;
+}
+
 void 
 entries_da_init(entries_da* da) {
   da->cap = DA_INIT_CAP;
   da->count = 0;
-  da->entries = (todo_entry**)malloc(sizeof(todo_entry) * da->cap);
+  da->entries = (todo_entry**)mem_alloc(MEM_ARRAYS, sizeof(todo_entry*) * da->cap);
 }
 
 void 
@@ -555,7 +1976,7 @@ entries_da_push(entries_da* da, todo_entry* entry) {
 
 void 
 entries_da_resize(entries_da* da, int32_t new_cap) {
-    todo_entry** temp = (todo_entry**)realloc(da->entries, new_cap * sizeof(todo_entry));
+    todo_entry** temp = (todo_entry**)mem_realloc(MEM_ARRAYS, da->entries, new_cap * sizeof(todo_entry*));
     if (!temp) {
         fprintf(stderr, "Failed to reallocate memory\n");
         exit(EXIT_FAILURE);
@@ -565,190 +1986,3817 @@ entries_da_resize(entries_da* da, int32_t new_cap) {
 }
 
 void 
-entries_da_remove_i(entries_da* da, uint32_t i) {
+entries_da_remove_i(entries_da* da, uint32_t i, uint32_t n) {
   // Bounds check 
-  if (i < 0 || i >= da->count) {
+  if (i + n > da->count) {
     printf("Index out of bounds\n");
     return;
   }
 
-  // Remove element
-  for (uint32_t idx = i; idx < da->count - 1; idx++) {
-    da->entries[idx] = da->entries[idx + 1];
-  }
+  // Remove the n elements starting at i
+  memmove(&da->entries[i], &da->entries[i + n], (da->count - i - n) * sizeof(todo_entry*));
 
   // Decrease the count
-  da->count--;
+  da->count -= n;
+}
+
+void 
+entries_da_insert(entries_da* da, uint32_t i, todo_entry* entry) {
+  if(da->count == da->cap) {
+    entries_da_resize(da, da->cap * 2);
+  }
+  memmove(&da->entries[i + 1], &da->entries[i], (da->count - i) * sizeof(todo_entry*));
+  da->entries[i] = entry;
+  da->count++;
 }
 
-void entries_da_free(entries_da* da) {
-  if(da->entries)
-    free(da->entries);
+void entries_da_free(entries_da* da, bool free_entries) {
+  // Only the list owns its entries, the other arrays just point to them
+  if(free_entries) {
+    for(uint32_t i = 0; i < da->count; i++) {
+      free_entry(da->entries[i]);
+    }
+  }
+  mem_free(da->entries);
+  da->entries = NULL;
   da->cap = 0;
   da->count = 0;
 }
 
-int
-compare_entry_priority(const void* a, const void* b) {
-  todo_entry* entry_a = *(todo_entry**)a;
-  todo_entry* entry_b = *(todo_entry**)b;
-  return (entry_b->priority - entry_a->priority);
+void 
+init_tree(entries_da* da) {
+  // Restoring the parent links from the depths. The parent of an 
+  // entry is the closest entry before it that is one level up.
+  todo_entry* prev = NULL;
+  for(uint32_t i = 0; i < da->count; i++) {
+    todo_entry* entry = da->entries[i];
+    // A depth can at most be one more than the one of the previous 
+    // entry, broken files are flattened instead of rejected.
+    uint32_t maxdepth = prev ? prev->depth + 1 : 0;
+    if(entry->depth > maxdepth) {
+      entry->depth = maxdepth;
+    }
+    todo_entry* parent = prev;
+    while(parent && parent->depth >= entry->depth) {
+      parent = parent->parent;
+    }
+    entry->parent = parent;
+    entry->nsubtasks = 0;
+    entry->nsubtasks_done = 0;
+    prev = entry;
+  }
+  // Summing up the progress bottom up, children come after their parent
+  for(int64_t i = (int64_t)da->count - 1; i >= 0; i--) {
+    todo_entry* entry = da->entries[i];
+    if(entry->parent) {
+      entry->parent->nsubtasks += entry->nsubtasks + 1;
+      entry->parent->nsubtasks_done += entry->nsubtasks_done + entry->completed;
+    }
+  }
 }
 
 void 
-sort_entries_by_priority(entries_da* da) {
-  qsort(da->entries, da->count, sizeof(todo_entry*), compare_entry_priority);
+update_progress(todo_entry* entry, int32_t dtotal, int32_t ddone) {
+  // Changes below an entry only affect the progress of its ancestors
+  for(todo_entry* parent = entry->parent; parent; parent = parent->parent) {
+    parent->nsubtasks += dtotal;
+    parent->nsubtasks_done += ddone;
+  }
 }
 
-char* 
-get_command_output(const char* cmd) {
-    FILE *fp;
-    char buffer[1024];
-    char *result = NULL;
-    size_t result_size = 0;
-
-    // Opening a new pipe with the fiven command
-    fp = popen(cmd, "r");
-    if (fp == NULL) {
-        printf("Failed to run command\n");
-        return NULL;
-    }
+bool 
+entry_visible(const todo_entry* entry) {
+  for(todo_entry* parent = entry->parent; parent; parent = parent->parent) {
+    if(parent->collapsed) return false;
+  }
+  return true;
+}
 
-    // Reading the output
-    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        size_t buffer_len = strlen(buffer);
-        char *temp = realloc(result, result_size + buffer_len + 1);
-        if (temp == NULL) {
-            printf("Memory allocation failed\n");
-            free(result);
-            pclose(fp);
-            return NULL;
-        }
-        result = temp;
-        strcpy(result + result_size, buffer);
-        result_size += buffer_len;
-    }
-    pclose(fp);
-    return result;
+int32_t 
+find_entry(const todo_entry* entry) {
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    if(s.todo_entries.entries[i] == entry) return i;
+  }
+  return -1;
 }
 
 void 
-serialize_todo_entry(FILE* file, todo_entry* entry) {
-  // Write completed to file
-  fwrite(&entry->completed, sizeof(bool), 1, file);
+insert_entry(todo_entry* entry, todo_entry* parent) {
+  // New entries get their id here, entries that come in 
+  // with a delta already have one.
+  if(!entry->id) {
+    stamp_entry(entry);
+  }
+  // Subtasks are appended to the end of their parents subtree 
+  int32_t parent_idx = parent ? find_entry(parent) : -1;
+  if(parent_idx == -1) {
+    entry->parent = NULL;
+    entry->depth = 0;
+    entries_da_push(&s.todo_entries, entry);
+  } else {
+    entry->parent = parent;
+    entry->depth = parent->depth + 1;
+    entries_da_insert(&s.todo_entries, parent_idx + parent->nsubtasks + 1, entry);
+  }
+  update_progress(entry, entry->nsubtasks + 1, entry->nsubtasks_done + entry->completed);
+  stats_add_entry(entry, 1);
+}
 
-  // Write description to file
-  size_t desc_len = strlen(entry->desc) + 1; // +1 for null terminator
-  // Writing the description length to the file for later 
-  // deserialization
-  fwrite(&desc_len, sizeof(size_t), 1, file);
-  fwrite(entry->desc, sizeof(char), desc_len, file);
+uint32_t 
+remove_entry(uint32_t i) {
+  // Removing a task removes all of its subtasks as well
+  todo_entry* entry = s.todo_entries.entries[i];
+  uint32_t n = entry->nsubtasks + 1;
+  update_progress(entry, -(int32_t)n, -(int32_t)(entry->nsubtasks_done + entry->completed));
+  // The removal is one change, all removed entries are tombstoned with it
+  tombstone* tombstones = mem_alloc(MEM_ARRAYS, n * sizeof(tombstone));
+  uint32_t ntombstones = 0;
+  uint64_t seq = ++s.seq;
+  for(uint32_t j = i; j < i + n; j++) {
+    todo_entry* removed = s.todo_entries.entries[j];
+    if(removed->heap_idx != -1) {
+      deadline_heap_remove(removed);
+    }
+    if(removed == s.new_task_parent) {
+      s.new_task_parent = NULL;
+    }
+    if(removed == s.notes_entry) {
+      close_notes();
+    }
+    if(removed->id) {
+      tombstones[ntombstones++] = (tombstone){.id = removed->id, .seq = seq};
+    }
+    stats_add_entry(removed, -1);
+    free_entry(removed);
+  }
+  append_tombstones(tombstones, ntombstones);
+  mem_free(tombstones);
+  entries_da_remove_i(&s.todo_entries, i, n);
+  return n;
+}
 
-  // Write date to file
-  size_t date_len = strlen(entry->date) + 1; // +1 for null terminator
-  // Writing the date length to the file for later 
-  // deserialization
-  fwrite(&date_len, sizeof(size_t), 1, file);
-  fwrite(entry->date, sizeof(char), date_len, file);
+void 
+raise_entry(uint32_t i) {
+  // Moving the subtree of the entry to the top of its siblings 
+  todo_entry* entry = s.todo_entries.entries[i];
+  uint32_t first = entry->parent ? find_entry(entry->parent) + 1 : 0;
+  uint32_t n = entry->nsubtasks + 1;
+  if(first == i) return;
 
-  // Write priority to file
-  fwrite(&entry->priority, sizeof(entry_priority), 1, file);
+  todo_entry** tmp = mem_alloc(MEM_ARRAYS, n * sizeof(todo_entry*));
+  memcpy(tmp, &s.todo_entries.entries[i], n * sizeof(todo_entry*));
+  memmove(&s.todo_entries.entries[first + n], &s.todo_entries.entries[first], 
+          (i - first) * sizeof(todo_entry*));
+  memcpy(&s.todo_entries.entries[first], tmp, n * sizeof(todo_entry*));
+  mem_free(tmp);
 }
 
-void
-serialize_todo_list(const char* filename, entries_da* da) {
-  FILE* file = fopen(filename, "wb");
-  if(!file) {
-    printf("Failed to open data file.\n");
-    return;
-  }
-  for(uint32_t i = 0; i < da->count; i++) {
-    serialize_todo_entry(file, da->entries[i]);
+bool 
+move_entry(todo_entry* entry, todo_entry* parent) {
+  // A task can't become a subtask of itself or of one of its subtasks
+  for(todo_entry* p = parent; p; p = p->parent) {
+    if(p == entry) return false;
   }
-  fclose(file);
+  todo_entry** block;
+  uint32_t n = take_subtree(find_entry(entry), &block);
+  place_subtree(block, n, parent, NULL);
+  mem_free(block);
+  return true;
 }
 
-todo_entry*  
-deserialize_todo_entry(FILE* file) {
-  // Allocate entry
-  todo_entry *entry = malloc(sizeof(todo_entry));
-
-  // Read if entry is completed
-  if (fread(&entry->completed, sizeof(bool), 1, file) != 1) {
-    free(entry);
-    return NULL;
+void 
+sort_entry(todo_entry* entry) {
+  // Moves the subtree of a single entry to where sorting the list 
+  // would put it, the other entries are sorted already.
+  entries_da* da = &s.todo_entries;
+  uint32_t i = find_entry(entry);
+  todo_entry** block;
+  uint32_t n = take_subtree(i, &block);
+  uint32_t first = entry->parent ? find_entry(entry->parent) + 1 : 0;
+  uint32_t end = entry->parent ? first + entry->parent->nsubtasks : da->count;
+  todo_entry* anchor = NULL;
+  for(uint32_t j = first; j < end; j += da->entries[j]->nsubtasks + 1) {
+    todo_entry* sibling = da->entries[j];
+    if(sibling->priority < entry->priority || (sibling->priority == entry->priority && j >= i)) {
+      anchor = sibling;
+      break;
+    }
   }
+  place_subtree(block, n, entry->parent, anchor);
+  mem_free(block);
+}
 
-  // Read the length of the description
-  size_t desc_len;
-  if (fread(&desc_len, sizeof(size_t), 1, file) != 1) {
-    free(entry);
-    return NULL;
-  }
-  
-  // Allocating space to store the entries description
-  entry->desc = malloc(desc_len);
-  if (!entry->desc) {
-    free(entry);
-    return NULL;
-  }
-  // Read the description from the file
-  if (fread(entry->desc, sizeof(char), desc_len, file) != desc_len) {
-    free(entry->desc);
-    free(entry);
-    return NULL;
-  }
+uint32_t 
+take_subtree(uint32_t i, todo_entry*** block) {
+  // Takes the subtree at i out of the list without removing it
+  todo_entry* entry = s.todo_entries.entries[i];
+  uint32_t n = entry->nsubtasks + 1;
+  update_progress(entry, -(int32_t)n, -(int32_t)(entry->nsubtasks_done + entry->completed));
+  *block = mem_alloc(MEM_ARRAYS, n * sizeof(todo_entry*));
+  memcpy(*block, &s.todo_entries.entries[i], n * sizeof(todo_entry*));
+  entries_da_remove_i(&s.todo_entries, i, n);
+  return n;
+}
 
-  // Read the date length from the file
-  size_t date_len;
-  if (fread(&date_len, sizeof(size_t), 1, file) != 1) {
-    free(entry->desc);
-    free(entry);
-    return NULL;
-  }
-  // Allocating space for the date
-  entry->date = malloc(date_len);
-  if (!entry->date) {
-    free(entry->desc);
-    free(entry);
-    return NULL;
+void 
+place_subtree(todo_entry** block, uint32_t n, todo_entry* parent, todo_entry* anchor) {
+  // The subtree goes in front of its next sibling (the anchor) or 
+  // to the end of the subtasks of its parent.
+  entries_da* da = &s.todo_entries;
+  todo_entry* root = block[0];
+  int32_t ddepth = (int32_t)(parent ? parent->depth + 1 : 0) - (int32_t)root->depth;
+  for(uint32_t j = 0; j < n; j++) {
+    block[j]->depth += ddepth;
   }
-  // Reading the date string
-  if (fread(entry->date, sizeof(char), date_len, file) != date_len) {
-    free(entry->desc);
-    free(entry->date);
-    free(entry);
-    return NULL;
+  uint32_t at;
+  if(anchor && anchor->parent == parent) {
+    at = find_entry(anchor);
+  } else {
+    at = parent ? find_entry(parent) + parent->nsubtasks + 1 : da->count;
   }
-
-  // Reading the entires priority
-  if (fread(&entry->priority, sizeof(entry_priority), 1, file) != 1) {
-    free(entry->desc);
-    free(entry->date);
-    free(entry);
-    return NULL;
+  while(da->count + n > da->cap) {
+    entries_da_resize(da, da->cap * 2);
   }
+  memmove(&da->entries[at + n], &da->entries[at], (da->count - at) * sizeof(todo_entry*));
+  memcpy(&da->entries[at], block, n * sizeof(todo_entry*));
+  da->count += n;
 
-  return entry;
+  root->parent = parent;
+  update_progress(root, n, root->nsubtasks_done + root->completed);
 }
-void deserialize_todo_list(const char* filename, entries_da* da) {
-  FILE *file = fopen(filename, "rb");
-  if(!file) {
-    // If file does not exist, create it 
-    file = fopen(filename, "w");
-    fclose(file);
-  }
-  file = fopen(filename, "rb");
-  todo_entry *entry;
-  while ((entry = deserialize_todo_entry(file)) != NULL) {
-    entries_da_push(da, entry);
+
+uint64_t 
+next_sibling_id(uint32_t i) {
+  todo_entry* entry = s.todo_entries.entries[i];
+  uint32_t next = i + entry->nsubtasks + 1;
+  if(next < s.todo_entries.count && s.todo_entries.entries[next]->parent == entry->parent) {
+    return s.todo_entries.entries[next]->id;
   }
-  fclose(file);
+  return 0;
 }
 
-void print_requires_argument(const char* option, uint32_t numargs) {
-  printf("todo: option requires %i argument(s): '%s'\n", numargs, option);
-  printf("Try todo --help for more information\n");
+void 
+init_entry(todo_entry* entry) {
+  // Runtime state of a newly created entry
+  entry->due = 0;
+  entry->overdue = false;
+  entry->heap_idx = -1;
+  entry->pos = 0;
+  entry->parent = NULL;
+  entry->depth = 0;
+  entry->collapsed = false;
+  entry->nsubtasks = 0;
+  entry->nsubtasks_done = 0;
+  entry->id = 0;
+  memset(entry->seqs, 0, sizeof(entry->seqs));
+  entry->note_offset = 0;
+  entry->note_size = 0;
+}
+
+void 
+free_entry(todo_entry* entry) {
+  mem_free(entry->desc);
+  mem_free(entry->date);
+  mem_free(entry);
+}
+
+void 
+free_list() {
+  // Freeing the loaded list & everything built on top of it
+  close_notes();
+  mem_free(s.notes_buf.data);
+  s.notes_buf = (exchange_buf){0};
+  entries_da_free(&s.todo_entries, true);
+  entries_da_free(&s.deadlines, false);
+  index_free();
+}
+
+void 
+stamp_entry(todo_entry* entry) {
+  // Creating an entry is a single change of all of its fields
+  entry->id = new_entry_id();
+  uint64_t seq = ++s.seq;
+  for(uint32_t i = 0; i < SYNC_FIELD_COUNT; i++) {
+    entry->seqs[i] = seq;
+  }
+}
+
+void 
+touch_entry(todo_entry* entry, sync_field field) {
+  entry->seqs[field] = ++s.seq;
+}
+
+uint64_t 
+new_entry_id() {
+  // Ids are random so synced lists can create entries independently 
+  // of each other. The generator (splitmix64) is seeded once.
+  static uint64_t state = 0;
+  if(!state) {
+    FILE* file = fopen("/dev/urandom", "rb");
+    if(!file || fread(&state, sizeof(state), 1, file) != 1) {
+      state = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    }
+    if(file) fclose(file);
+  }
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return z ? z : 1;
+}
+
+int
+compare_entry_priority(const void* a, const void* b) {
+  todo_entry* entry_a = *(todo_entry**)a;
+  todo_entry* entry_b = *(todo_entry**)b;
+  // Entries with the same priority keep their order, so changing the 
+  // priority of one entry only moves that entry.
+  if(entry_a->priority != entry_b->priority) {
+    return (entry_b->priority - entry_a->priority);
+  }
+  return (entry_a->pos > entry_b->pos) - (entry_a->pos < entry_b->pos);
+}
+
+void 
+sort_entries_by_priority(entries_da* da) {
+  // Siblings are sorted, every subtree moves together with its root
+  if(!da->count) return;
+  for(uint32_t i = 0; i < da->count; i++) {
+    da->entries[i]->pos = i;
+  }
+  todo_entry** sorted = mem_alloc(MEM_ARRAYS, da->count * sizeof(todo_entry*));
+  uint32_t out = 0;
+  sort_siblings(da->entries, 0, da->count, sorted, &out);
+  memcpy(da->entries, sorted, da->count * sizeof(todo_entry*));
+  mem_free(sorted);
+}
+
+void 
+sort_siblings(todo_entry** src, uint32_t begin, uint32_t end, todo_entry** dst, uint32_t* out) {
+  // Collecting the roots of the subtrees within [begin, end)
+  uint32_t nroots = 0;
+  for(uint32_t i = begin; i < end; i += src[i]->nsubtasks + 1) {
+    nroots++;
+  }
+  todo_entry** roots = mem_alloc(MEM_ARRAYS, nroots * sizeof(todo_entry*));
+  nroots = 0;
+  for(uint32_t i = begin; i < end; i += src[i]->nsubtasks + 1) {
+    roots[nroots++] = src[i];
+  }
+  qsort(roots, nroots, sizeof(todo_entry*), compare_entry_priority);
+
+  for(uint32_t i = 0; i < nroots; i++) {
+    todo_entry* root = roots[i];
+    dst[(*out)++] = root;
+    if(root->nsubtasks) {
+      sort_siblings(src, root->pos + 1, root->pos + 1 + root->nsubtasks, dst, out);
+    }
+  }
+  mem_free(roots);
+}
+
+int32_t 
+find_tag(tag_table* tags, const char* name) {
+  for(uint32_t i = 0; i < tags->count; i++) {
+    if(tags->names[i][0] && strcmp(tags->names[i], name) == 0) return i;
+  }
+  return -1;
+}
+
+int32_t 
+add_tag(tag_table* tags, const char* name) {
+  // Once the table is full, the slots of dropped tags are reused
+  uint32_t tag = tags->count;
+  if(tag == MAX_TAGS) {
+    for(tag = 0; tag < MAX_TAGS && tags->names[tag][0]; tag++);
+    if(tag == MAX_TAGS) return -1;
+  }
+  snprintf(tags->names[tag], TAG_NAME_SIZE, "%s", name);
+  if(tag == tags->count) tags->count++;
+  return tag;
+}
+
+uint64_t 
+tag_mask(const tag_table* tags) {
+  uint64_t mask = 0;
+  for(uint32_t i = 0; i < tags->count; i++) {
+    if(tags->names[i][0]) mask |= 1ULL << i;
+  }
+  return mask;
+}
+
+void 
+drop_unused_tags() {
+  // Tags no task uses anymore are dropped once the table is full, so it 
+  // doesn't stay full for good. The other tags keep their slots, so the 
+  // tag masks of the tasks & of the undo logs don't change.
+  if(s.tags.count < MAX_TAGS) return;
+  uint64_t used = 0;
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    used |= s.todo_entries.entries[i]->tags;
+  }
+  if((used & tag_mask(&s.tags)) == tag_mask(&s.tags)) return;
+  for(uint32_t i = 0; i < s.tags.count; i++) {
+    if(!((used >> i) & 1)) s.tags.names[i][0] = '\0';
+  }
+  while(s.tags.count && !s.tags.names[s.tags.count - 1][0]) {
+    s.tags.count--;
+  }
+  s.crnt_filter.tags &= used;
+  index_invalidate();
+}
+
+uint64_t 
+parse_tags(tag_table* tags, const char* str, bool create, uint32_t* dropped) {
+  // Parsing a comma separated list of tag names into a tag mask.
+  // Tags that don't fit into the table are counted in dropped if given,
+  // otherwise they are reported right away.
+  uint64_t mask = 0;
+  while(*str) {
+    while(*str == ',' || isspace((unsigned char)*str)) str++;
+    const char* begin = str;
+    while(*str && *str != ',') str++;
+    const char* end = str;
+    while(end > begin && isspace((unsigned char)end[-1])) end--;
+    if(end == begin) continue;
+
+    char name[TAG_NAME_SIZE];
+    size_t len = (size_t)(end - begin) < TAG_NAME_SIZE - 1 ? (size_t)(end - begin) : TAG_NAME_SIZE - 1;
+    memcpy(name, begin, len);
+    name[len] = '\0';
+    str_to_lower(name);
+
+    int32_t tag = find_tag(tags, name);
+    if(tag == -1 && create) {
+      tag = add_tag(tags, name);
+      if(tag == -1) {
+        if(dropped) {
+          (*dropped)++;
+        } else {
+          printf("todo: cannot have more than %i tags in a list.\n", MAX_TAGS);
+        }
+      }
+    }
+    if(tag != -1) {
+      mask |= 1ULL << tag;
+    }
+  }
+  return mask;
+}
+
+void 
+format_tags(tag_table* tags, uint64_t mask, char* buf, size_t size) {
+  size_t len = 0;
+  buf[0] = '\0';
+  for(uint64_t m = mask; m && len < size; m &= m - 1) {
+    uint32_t tag = __builtin_ctzll(m);
+    len += snprintf(buf + len, size - len, "%s#%s", len ? " " : "", tags->names[tag]);
+  }
+}
+
+void 
+bitmap_resize(bitmap* b, uint32_t nbits) {
+  uint32_t nwords = (nbits + 63) / 64;
+  if(nwords != b->nwords) {
+    uint64_t* temp = (uint64_t*)mem_realloc(MEM_ARRAYS, b->words, (nwords ? nwords : 1) * sizeof(uint64_t));
+    if (!temp) {
+      fprintf(stderr, "Failed to reallocate memory\n");
+      exit(EXIT_FAILURE);
+    }
+    b->words = temp;
+    b->nwords = nwords;
+  }
+  memset(b->words, 0, nwords * sizeof(uint64_t));
+}
+
+void 
+bitmap_set(bitmap* b, uint32_t i, bool val) {
+  if(val) {
+    b->words[i / 64] |= 1ULL << (i % 64);
+  } else {
+    b->words[i / 64] &= ~(1ULL << (i % 64));
+  }
+}
+
+void 
+bitmap_fill(bitmap* b, uint32_t nbits) {
+  bitmap_resize(b, nbits);
+  memset(b->words, 0xff, b->nwords * sizeof(uint64_t));
+  if(nbits % 64) {
+    b->words[b->nwords - 1] = (1ULL << (nbits % 64)) - 1;
+  }
+}
+
+int64_t 
+bitmap_next(const bitmap* b, uint32_t from) {
+  uint32_t w = from / 64;
+  if(w >= b->nwords) return -1;
+  // Masking out the bits before from in the first word
+  uint64_t word = b->words[w] & (~0ULL << (from % 64));
+  while(!word) {
+    if(++w >= b->nwords) return -1;
+    word = b->words[w];
+  }
+  return (int64_t)w * 64 + __builtin_ctzll(word);
+}
+
+void 
+bitmap_and_any(bitmap* dst, bitmap** srcs, uint32_t nsrcs) {
+  // dst &= (srcs[0] | srcs[1] | ...)
+  for(uint32_t w = 0; w < dst->nwords; w++) {
+    uint64_t any = 0;
+    for(uint32_t i = 0; i < nsrcs; i++) {
+      any |= srcs[i]->words[w];
+    }
+    dst->words[w] &= any;
+  }
+}
+
+void 
+bitmap_free(bitmap* b) {
+  mem_free(b->words);
+  b->words = NULL;
+  b->nwords = 0;
+}
+
+void 
+index_invalidate() {
+  s.index.dirty = true;
+  s.query_dirty = true;
+}
+
+void 
+index_rebuild() {
+  entry_index* idx = &s.index;
+  uint32_t count = s.todo_entries.count;
+  for(uint32_t i = 0; i < 2; i++) {
+    bitmap_resize(&idx->states[i], count);
+  }
+  for(uint32_t i = 0; i < PRIORITY_COUNT; i++) {
+    bitmap_resize(&idx->priorities[i], count);
+  }
+  bitmap_resize(&idx->overdue, count);
+  bitmap_resize(&idx->visible, count);
+  // Only the tags that exist in the list get a bitmap
+  for(uint32_t i = 0; i < s.tags.count; i++) {
+    bitmap_resize(&idx->tags[i], count);
+  }
+  // Tags are resolved when the query is compiled, so it is 
+  // recompiled in case the tag table changed.
+  if(s.query_src[0]) {
+    char err[128];
+    query_compile(s.query_src, &s.tags, &s.query, err, sizeof(err));
+  }
+
+  // Collapsed subtrees are skipped as a whole
+  for(uint32_t i = 0; i < count; i += s.todo_entries.entries[i]->collapsed ? 
+      s.todo_entries.entries[i]->nsubtasks + 1 : 1) {
+    todo_entry* entry = s.todo_entries.entries[i];
+    entry->pos = i;
+    bitmap_set(&idx->visible, i, true);
+    bitmap_set(&idx->states[entry->completed], i, true);
+    bitmap_set(&idx->priorities[entry->priority], i, true);
+    // Overdue state is maintained as deadlines pass, not recomputed here
+    bitmap_set(&idx->overdue, i, entry->overdue);
+    for(uint64_t m = entry->tags; m; m &= m - 1) {
+      bitmap_set(&idx->tags[__builtin_ctzll(m)], i, true);
+    }
+  }
+  idx->dirty = false;
+}
+
+void 
+index_update_entry(uint32_t i) {
+  if(s.index.dirty) return;
+  entry_index* idx = &s.index;
+  todo_entry* entry = s.todo_entries.entries[i];
+
+  bitmap_set(&idx->states[0], i, !entry->completed);
+  bitmap_set(&idx->states[1], i, entry->completed);
+  for(uint32_t p = 0; p < PRIORITY_COUNT; p++) {
+    bitmap_set(&idx->priorities[p], i, entry->priority == (entry_priority)p);
+  }
+  bitmap_set(&idx->overdue, i, entry->overdue);
+  // A tag that was created after the last rebuild has no bitmap yet
+  for(uint32_t t = 0; t < s.tags.count; t++) {
+    if(idx->tags[t].nwords * 64 < s.todo_entries.count) {
+      index_invalidate();
+      return;
+    }
+    bitmap_set(&idx->tags[t], i, (entry->tags >> t) & 1);
+  }
+  if(s.query.count && !s.query_dirty) {
+    bitmap_set(&s.query_result, i, query_eval(&s.query, entry));
+  }
+}
+
+bitmap* 
+index_eval_filter(const todo_filter* filter) {
+  if(s.index.dirty) {
+    index_rebuild();
+  }
+  entry_index* idx = &s.index;
+  bitmap* result = &idx->result;
+  bitmap_fill(result, s.todo_entries.count);
+  bitmap* visible = &idx->visible;
+  bitmap_and_any(result, &visible, 1);
+
+  // Every group of the filter is an OR over its bitmaps, 
+  // the groups themselves are combined with AND.
+  bitmap* srcs[PRIORITY_COUNT];
+  uint32_t nsrcs = 0;
+  if(filter->states) {
+    if(filter->states & FILTER_STATE_IN_PROGRESS) srcs[nsrcs++] = &idx->states[0];
+    if(filter->states & FILTER_STATE_COMPLETED) srcs[nsrcs++] = &idx->states[1];
+    bitmap_and_any(result, srcs, nsrcs);
+  }
+  if(filter->priorities) {
+    nsrcs = 0;
+    for(uint32_t p = 0; p < PRIORITY_COUNT; p++) {
+      if(filter->priorities & (1 << p)) srcs[nsrcs++] = &idx->priorities[p];
+    }
+    bitmap_and_any(result, srcs, nsrcs);
+  }
+  for(uint64_t m = filter->tags; m; m &= m - 1) {
+    uint32_t tag = __builtin_ctzll(m);
+    if(tag >= s.tags.count) continue;
+    bitmap* src = &idx->tags[tag];
+    bitmap_and_any(result, &src, 1);
+  }
+  if(filter->overdue) {
+    bitmap* src = &idx->overdue;
+    bitmap_and_any(result, &src, 1);
+  }
+
+  // The query is only evaluated over all entries when they or the 
+  // query changed, otherwise its cached result is reused.
+  if(s.query.count) {
+    if(s.query_dirty) {
+      bitmap_resize(&s.query_result, s.todo_entries.count);
+      for(int64_t i = bitmap_next(visible, 0); i != -1; i = bitmap_next(visible, i + 1)) {
+        if(query_eval(&s.query, s.todo_entries.entries[i])) {
+          bitmap_set(&s.query_result, i, true);
+        }
+      }
+      s.query_dirty = false;
+    }
+    bitmap* src = &s.query_result;
+    bitmap_and_any(result, &src, 1);
+  }
+  return result;
+}
+
+void 
+index_free() {
+  entry_index* idx = &s.index;
+  for(uint32_t i = 0; i < 2; i++) {
+    bitmap_free(&idx->states[i]);
+  }
+  for(uint32_t i = 0; i < PRIORITY_COUNT; i++) {
+    bitmap_free(&idx->priorities[i]);
+  }
+  for(uint32_t i = 0; i < MAX_TAGS; i++) {
+    bitmap_free(&idx->tags[i]);
+  }
+  bitmap_free(&idx->overdue);
+  bitmap_free(&idx->visible);
+  bitmap_free(&idx->result);
+  bitmap_free(&s.query_result);
+  query_free(&s.query);
+}
+
+void 
+init_deadlines() {
+  s.deadlines.count = 0;
+  if(!s.deadlines.entries) {
+    entries_da_init(&s.deadlines);
+  }
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    s.todo_entries.entries[i]->heap_idx = -1;
+    update_deadline(s.todo_entries.entries[i]);
+  }
+}
+
+void 
+remind_overdue() {
+  // Deadlines that passed while the list wasn't open are 
+  // never seen by process_deadlines, so they are reminded of once here.
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    if(s.todo_entries.entries[i]->overdue) {
+      send_reminder(s.todo_entries.entries[i]);
+    }
+  }
+}
+
+void 
+update_deadline(todo_entry* entry) {
+  // Entries with a due date in the future wait in the heap, 
+  // the ones whose due date passed are overdue until completed.
+  bool pending = entry->due && !entry->completed;
+  entry->overdue = pending && entry->due <= (int64_t)time(NULL);
+  bool in_heap = pending && !entry->overdue;
+
+  if(in_heap && entry->heap_idx == -1) {
+    deadline_heap_push(entry);
+  } else if(!in_heap && entry->heap_idx != -1) {
+    deadline_heap_remove(entry);
+  } else if(in_heap) {
+    // Due date changed while in the heap
+    deadline_heap_sift_up(entry->heap_idx);
+    deadline_heap_sift_down(entry->heap_idx);
+  }
+}
+
+void 
+deadline_heap_push(todo_entry* entry) {
+  entries_da_push(&s.deadlines, entry);
+  entry->heap_idx = s.deadlines.count - 1;
+  deadline_heap_sift_up(entry->heap_idx);
+}
+
+void 
+deadline_heap_remove(todo_entry* entry) {
+  uint32_t i = entry->heap_idx;
+  uint32_t last = s.deadlines.count - 1;
+  if(i != last) {
+    deadline_heap_swap(i, last);
+  }
+  s.deadlines.count--;
+  entry->heap_idx = -1;
+  if(i < s.deadlines.count) {
+    deadline_heap_sift_up(i);
+    deadline_heap_sift_down(i);
+  }
+}
+
+void 
+deadline_heap_swap(uint32_t a, uint32_t b) {
+  todo_entry** heap = s.deadlines.entries;
+  todo_entry* tmp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = tmp;
+  heap[a]->heap_idx = a;
+  heap[b]->heap_idx = b;
+}
+
+void 
+deadline_heap_sift_up(uint32_t i) {
+  todo_entry** heap = s.deadlines.entries;
+  while(i > 0 && heap[(i - 1) / 2]->due > heap[i]->due) {
+    deadline_heap_swap(i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+void 
+deadline_heap_sift_down(uint32_t i) {
+  todo_entry** heap = s.deadlines.entries;
+  while(true) {
+    uint32_t smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+    if(l < s.deadlines.count && heap[l]->due < heap[smallest]->due) smallest = l;
+    if(r < s.deadlines.count && heap[r]->due < heap[smallest]->due) smallest = r;
+    if(smallest == i) break;
+    deadline_heap_swap(i, smallest);
+    i = smallest;
+  }
+}
+
+void 
+process_deadlines() {
+  // Only the deadlines that passed are looked at
+  int64_t now = (int64_t)time(NULL);
+  while(s.deadlines.count && s.deadlines.entries[0]->due <= now) {
+    todo_entry* entry = s.deadlines.entries[0];
+    deadline_heap_remove(entry);
+    entry->overdue = true;
+    if(entry_visible(entry)) {
+      index_update_entry(entry->pos);
+    }
+    send_reminder(entry);
+  }
+  // Reaping finished reminder processes
+  while(waitpid(-1, NULL, WNOHANG) > 0);
+}
+
+void 
+wait_events() {
+  // Rendering a few frames after every wake up, so changes made while 
+  // handling input become visible without further events.
+  if(s.redraw_frames) {
+    s.redraw_frames--;
+    glfwPollEvents();
+    return;
+  }
+  if(s.deadlines.count) {
+    double timeout = (double)(s.deadlines.entries[0]->due - (int64_t)time(NULL));
+    glfwWaitEventsTimeout(timeout > 0.0 ? timeout : 0.0);
+  } else {
+    glfwWaitEvents();
+  }
+  s.redraw_frames = REDRAW_FRAMES;
+}
+
+void 
+send_reminder(todo_entry* entry) {
+  if(s.input.mode != INPUT_LIVE) return;
+  // Spawning the command directly so the description 
+  // is never interpreted by a shell.
+  char* argv[] = {(char*)REMINDER_CMD, (char*)"todo", entry->desc, NULL};
+  extern char** environ;
+  pid_t pid;
+  if(posix_spawnp(&pid, REMINDER_CMD, NULL, NULL, argv, environ) != 0) {
+    printf("todo: failed to run reminder command '%s'.\n", REMINDER_CMD);
+  }
+}
+
+int64_t 
+parse_due(const char* str) {
+  // Accepting the format of DATE_CMD, with or without 
+  // the comma & time (which defaults to the end of the day).
+  struct tm tm;
+  static const char* formats[] = {
+    "%d.%m.%Y, %H:%M", "%d.%m.%Y %H:%M", "%d.%m.%Y"
+  };
+  for(uint32_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    memset(&tm, 0, sizeof(tm));
+    if(i == 2) {
+      tm.tm_hour = 23;
+      tm.tm_min = 59;
+    }
+    const char* end = strptime(str, formats[i], &tm);
+    if(end && *end == '\0') {
+      tm.tm_isdst = -1;
+      return (int64_t)mktime(&tm);
+    }
+  }
+  return -1;
+}
+
+void 
+format_due(int64_t due, char* buf, size_t size) {
+  time_t t = (time_t)due;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  strftime(buf, size, "%d.%m.%Y, %H:%M", &tm);
+}
+
+void 
+query_next_token(query_parser* p) {
+  while(isspace((unsigned char)*p->pos)) p->pos++;
+  p->text[0] = '\0';
+  char c = *p->pos;
+  if(!c) {
+    p->tok = QTOK_END;
+    return;
+  }
+  if(c == '(' || c == ')') {
+    p->tok = c == '(' ? QTOK_LPAREN : QTOK_RPAREN;
+    p->pos++;
+    return;
+  }
+  if((c == '&' && p->pos[1] == '&') || (c == '|' && p->pos[1] == '|')) {
+    p->tok = c == '&' ? QTOK_AND : QTOK_OR;
+    p->pos += 2;
+    return;
+  }
+  if(c == '!' && p->pos[1] != '=') {
+    p->tok = QTOK_NOT;
+    p->pos++;
+    return;
+  }
+  if(strchr("=!<>~", c)) {
+    // Comparison operators: = == != < <= > >= ~
+    size_t len = (p->pos[1] == '=' && c != '~') ? 2 : 1;
+    if(c == '=' && len == 2) {
+      strcpy(p->text, "=");
+    } else {
+      memcpy(p->text, p->pos, len);
+      p->text[len] = '\0';
+    }
+    p->tok = QTOK_CMP;
+    p->pos += len;
+    return;
+  }
+  if(c == '"' || c == '\'') {
+    const char* end = strchr(p->pos + 1, c);
+    if(!end || (size_t)(end - p->pos - 1) >= sizeof(p->text)) {
+      snprintf(p->err, p->errsize, "unterminated string");
+      p->tok = QTOK_ERROR;
+      return;
+    }
+    memcpy(p->text, p->pos + 1, end - p->pos - 1);
+    p->text[end - p->pos - 1] = '\0';
+    p->tok = QTOK_STRING;
+    p->pos = end + 1;
+    return;
+  }
+  bool tag = c == '#';
+  if(tag) p->pos++;
+  size_t len = 0;
+  while((isalnum((unsigned char)p->pos[len]) || strchr("_-.", p->pos[len])) && p->pos[len]) len++;
+  if(!len || len >= sizeof(p->text)) {
+    snprintf(p->err, p->errsize, "unexpected character '%c'", *p->pos);
+    p->tok = QTOK_ERROR;
+    return;
+  }
+  memcpy(p->text, p->pos, len);
+  p->text[len] = '\0';
+  p->pos += len;
+  str_to_lower(p->text);
+  if(tag) {
+    p->tok = QTOK_TAG;
+  } else if(strcmp(p->text, "and") == 0) {
+    p->tok = QTOK_AND;
+  } else if(strcmp(p->text, "or") == 0) {
+    p->tok = QTOK_OR;
+  } else if(strcmp(p->text, "not") == 0) {
+    p->tok = QTOK_NOT;
+  } else {
+    p->tok = QTOK_IDENT;
+  }
+}
+
+query_node* 
+query_new_node(query_node_type type, query_node* lhs, query_node* rhs) {
+  query_node* node = mem_calloc(MEM_OTHER, 1, sizeof(query_node));
+  node->type = type;
+  node->lhs = lhs;
+  node->rhs = rhs;
+  return node;
+}
+
+query_node* 
+query_parse_or(query_parser* p) {
+  query_node* lhs = query_parse_and(p);
+  while(lhs && p->tok == QTOK_OR) {
+    query_next_token(p);
+    query_node* rhs = query_parse_and(p);
+    if(!rhs) {
+      query_free_tree(lhs);
+      return NULL;
+    }
+    lhs = query_new_node(QNODE_OR, lhs, rhs);
+  }
+  return lhs;
+}
+
+query_node* 
+query_parse_and(query_parser* p) {
+  query_node* lhs = query_parse_unary(p);
+  while(lhs && p->tok == QTOK_AND) {
+    query_next_token(p);
+    query_node* rhs = query_parse_unary(p);
+    if(!rhs) {
+      query_free_tree(lhs);
+      return NULL;
+    }
+    lhs = query_new_node(QNODE_AND, lhs, rhs);
+  }
+  return lhs;
+}
+
+query_node* 
+query_parse_unary(query_parser* p) {
+  if(p->tok == QTOK_NOT) {
+    query_next_token(p);
+    query_node* operand = query_parse_unary(p);
+    return operand ? query_new_node(QNODE_NOT, operand, NULL) : NULL;
+  }
+  return query_parse_primary(p);
+}
+
+query_node* 
+query_parse_primary(query_parser* p) {
+  if(p->tok == QTOK_LPAREN) {
+    query_next_token(p);
+    query_node* node = query_parse_or(p);
+    if(node && p->tok != QTOK_RPAREN) {
+      snprintf(p->err, p->errsize, "expected ')'");
+      query_free_tree(node);
+      return NULL;
+    }
+    query_next_token(p);
+    return node;
+  }
+
+  query_node* node = query_new_node(QNODE_PRED, NULL, NULL);
+  // '#name' is short for 'tag=name'
+  if(p->tok == QTOK_TAG) {
+    strcpy(node->field, "tag");
+    strcpy(node->op, "=");
+    node->value = mem_strdup(MEM_OTHER, p->text);
+    query_next_token(p);
+    return node;
+  }
+  if(p->tok != QTOK_IDENT) {
+    if(p->tok != QTOK_ERROR) {
+      snprintf(p->err, p->errsize, "expected a field");
+    }
+    query_free_tree(node);
+    return NULL;
+  }
+  // Boolean fields stand on their own, all others are compared 
+  // against a value. Unknown fields are reported as they were given.
+  bool boolean = strcmp(p->text, "done") == 0 || strcmp(p->text, "completed") == 0 || 
+                 strcmp(p->text, "due") == 0 || strcmp(p->text, "overdue") == 0;
+  if(!boolean && strcmp(p->text, "priority") != 0 && strcmp(p->text, "desc") != 0 && 
+     strcmp(p->text, "tag") != 0) {
+    snprintf(p->err, p->errsize, "unknown field '%s'", p->text);
+    query_free_tree(node);
+    return NULL;
+  }
+  snprintf(node->field, sizeof(node->field), "%.*s", (int)sizeof(node->field) - 1, p->text);
+  query_next_token(p);
+  if(boolean) {
+    return node;
+  }
+  if(p->tok != QTOK_CMP) {
+    snprintf(p->err, p->errsize, "expected an operator after '%s'", node->field);
+    query_free_tree(node);
+    return NULL;
+  }
+  strcpy(node->op, p->text);
+  query_next_token(p);
+  if(p->tok != QTOK_IDENT && p->tok != QTOK_STRING) {
+    if(p->tok != QTOK_ERROR) {
+      snprintf(p->err, p->errsize, "expected a value after '%s%s'", node->field, node->op);
+    }
+    query_free_tree(node);
+    return NULL;
+  }
+  node->value = mem_strdup(MEM_OTHER, p->text);
+  query_next_token(p);
+
+  bool valid_op = strcmp(node->field, "desc") == 0 ? strcmp(node->op, "~") == 0 : 
+    strcmp(node->field, "tag") == 0 ? (strcmp(node->op, "=") == 0 || strcmp(node->op, "!=") == 0) : 
+    strcmp(node->op, "~") != 0;
+  if(!valid_op) {
+    snprintf(p->err, p->errsize, "invalid operator '%s' for '%s'", node->op, node->field);
+    query_free_tree(node);
+    return NULL;
+  }
+  if(strcmp(node->field, "priority") == 0 && parse_priority(node->value) == -1) {
+    snprintf(p->err, p->errsize, "invalid priority '%s'", node->value);
+    query_free_tree(node);
+    return NULL;
+  }
+  return node;
+}
+
+query_node* 
+query_parse(const char* src, char* err, size_t errsize) {
+  query_parser p = {.src = src, .pos = src, .err = err, .errsize = errsize};
+  err[0] = '\0';
+  query_next_token(&p);
+  query_node* root = query_parse_or(&p);
+  if(root && p.tok != QTOK_END) {
+    snprintf(err, errsize, "unexpected input at '%s'", p.pos);
+    query_free_tree(root);
+    return NULL;
+  }
+  return root;
+}
+
+void 
+query_free_tree(query_node* node) {
+  if(!node) return;
+  query_free_tree(node->lhs);
+  query_free_tree(node->rhs);
+  mem_free(node->value);
+  mem_free(node);
+}
+
+uint32_t 
+query_emit(query_program* prog, query_instr instr) {
+  if(prog->count == prog->cap) {
+    prog->cap = prog->cap ? prog->cap * 2 : 16;
+    query_instr* temp = (query_instr*)mem_realloc(MEM_ARRAYS, prog->code, prog->cap * sizeof(query_instr));
+    if (!temp) {
+      fprintf(stderr, "Failed to reallocate memory\n");
+      exit(EXIT_FAILURE);
+    }
+    prog->code = temp;
+  }
+  prog->code[prog->count] = instr;
+  return prog->count++;
+}
+
+void 
+query_emit_node(query_program* prog, query_node* node, tag_table* tags) {
+  switch(node->type) {
+    case QNODE_AND:
+    case QNODE_OR: {
+      // The right side only runs if the left side did not decide the result
+      query_emit_node(prog, node->lhs, tags);
+      uint32_t jump = query_emit(prog, (query_instr){
+        .op = node->type == QNODE_AND ? QOP_JUMP_IF_FALSE : QOP_JUMP_IF_TRUE});
+      query_emit_node(prog, node->rhs, tags);
+      prog->code[jump].arg.target = prog->count;
+      break;
+    }
+    case QNODE_NOT:
+      query_emit_node(prog, node->lhs, tags);
+      query_emit(prog, (query_instr){.op = QOP_NOT});
+      break;
+    case QNODE_PRED: {
+      if(strcmp(node->field, "done") == 0 || strcmp(node->field, "completed") == 0) {
+        query_emit(prog, (query_instr){.op = QOP_DONE});
+      } 
+      else if(strcmp(node->field, "due") == 0) {
+        query_emit(prog, (query_instr){.op = QOP_DUE});
+      } 
+      else if(strcmp(node->field, "overdue") == 0) {
+        query_emit(prog, (query_instr){.op = QOP_OVERDUE});
+      } 
+      else if(strcmp(node->field, "priority") == 0) {
+        // Comparisons against a priority level become the set 
+        // of priorities that satisfy them.
+        int32_t level = parse_priority(node->value);
+        uint8_t mask = 0;
+        for(int32_t p = 0; p < PRIORITY_COUNT; p++) {
+          bool match = 
+            strcmp(node->op, "=") == 0 ? p == level :
+            strcmp(node->op, "!=") == 0 ? p != level :
+            strcmp(node->op, "<") == 0 ? p < level :
+            strcmp(node->op, "<=") == 0 ? p <= level :
+            strcmp(node->op, ">") == 0 ? p > level : p >= level;
+          if(match) mask |= 1 << p;
+        }
+        query_emit(prog, (query_instr){.op = QOP_PRIORITY, .arg.priorities = mask});
+      } 
+      else if(strcmp(node->field, "desc") == 0) {
+        query_emit(prog, (query_instr){.op = QOP_DESC, .arg.needle = mem_strdup(MEM_OTHER, node->value)});
+      } 
+      else if(strcmp(node->field, "tag") == 0) {
+        // Tags that do not exist in the list never match
+        int32_t tag = find_tag(tags, node->value);
+        if(tag == -1) {
+          query_emit(prog, (query_instr){.op = QOP_CONST, .arg.val = false});
+        } else {
+          query_emit(prog, (query_instr){.op = QOP_TAGS, .arg.tags = 1ULL << tag});
+        }
+        if(strcmp(node->op, "!=") == 0) {
+          query_emit(prog, (query_instr){.op = QOP_NOT});
+        }
+      }
+      break;
+    }
+  }
+}
+
+bool 
+query_compile(const char* src, tag_table* tags, query_program* prog, char* err, size_t errsize) {
+  query_node* root = query_parse(src, err, errsize);
+  if(!root) return false;
+  query_free(prog);
+  query_emit_node(prog, root, tags);
+  query_free_tree(root);
+  return true;
+}
+
+void 
+query_free(query_program* prog) {
+  for(uint32_t i = 0; i < prog->count; i++) {
+    if(prog->code[i].op == QOP_DESC) mem_free(prog->code[i].arg.needle);
+  }
+  mem_free(prog->code);
+  memset(prog, 0, sizeof(*prog));
+}
+
+bool 
+query_eval(const query_program* prog, const todo_entry* entry) {
+  bool r = true;
+  const query_instr* code = prog->code;
+  for(uint32_t pc = 0; pc < prog->count; pc++) {
+    const query_instr* in = &code[pc];
+    switch(in->op) {
+      case QOP_CONST:         r = in->arg.val; break;
+      case QOP_DONE:          r = entry->completed; break;
+      case QOP_PRIORITY:      r = (in->arg.priorities >> entry->priority) & 1; break;
+      case QOP_TAGS:          r = (entry->tags & in->arg.tags) != 0; break;
+      case QOP_DESC:          r = strcasestr(entry->desc, in->arg.needle) != NULL; break;
+      case QOP_DUE:           r = entry->due != 0; break;
+      case QOP_OVERDUE:       r = entry->overdue; break;
+      case QOP_NOT:           r = !r; break;
+      case QOP_JUMP_IF_FALSE: if(!r) pc = in->arg.target - 1; break;
+      case QOP_JUMP_IF_TRUE:  if(r) pc = in->arg.target - 1; break;
+    }
+  }
+  return r;
+}
+
+bool 
+query_interpret(const query_node* node, const todo_entry* entry, tag_table* tags) {
+  // Walks the tree and re-reads the query text for every entry. 
+  // Only used as the baseline for --bench-query.
+  switch(node->type) {
+    case QNODE_AND: 
+      return query_interpret(node->lhs, entry, tags) && query_interpret(node->rhs, entry, tags);
+    case QNODE_OR: 
+      return query_interpret(node->lhs, entry, tags) || query_interpret(node->rhs, entry, tags);
+    case QNODE_NOT: 
+      return !query_interpret(node->lhs, entry, tags);
+    case QNODE_PRED: 
+      if(strcmp(node->field, "done") == 0 || strcmp(node->field, "completed") == 0) {
+        return entry->completed;
+      }
+      if(strcmp(node->field, "due") == 0) {
+        return entry->due != 0;
+      }
+      if(strcmp(node->field, "overdue") == 0) {
+        return entry->overdue;
+      }
+      if(strcmp(node->field, "priority") == 0) {
+        int32_t p = entry->priority, level = parse_priority(node->value);
+        if(strcmp(node->op, "=") == 0) return p == level;
+        if(strcmp(node->op, "!=") == 0) return p != level;
+        if(strcmp(node->op, "<") == 0) return p < level;
+        if(strcmp(node->op, "<=") == 0) return p <= level;
+        if(strcmp(node->op, ">") == 0) return p > level;
+        return p >= level;
+      }
+      if(strcmp(node->field, "desc") == 0) {
+        return strcasestr(entry->desc, node->value) != NULL;
+      }
+      if(strcmp(node->field, "tag") == 0) {
+        int32_t tag = find_tag(tags, node->value);
+        bool tagged = tag != -1 && (entry->tags >> tag) & 1;
+        return strcmp(node->op, "!=") == 0 ? !tagged : tagged;
+      }
+      return false;
+  }
+  return false;
+}
+
+void 
+set_query(const char* src) {
+  char err[128];
+  s.query_error = false;
+  if(!strlen(src)) {
+    query_free(&s.query);
+    s.query_src[0] = '\0';
+  } else if(query_compile(src, &s.tags, &s.query, err, sizeof(err))) {
+    snprintf(s.query_src, sizeof(s.query_src), "%s", src);
+  } else {
+    s.query_error = true;
+  }
+  s.query_dirty = true;
+}
+
+int32_t 
+parse_priority(const char* str) {
+  if(strcasecmp(str, "low") == 0) return PRIORITY_LOW;
+  if(strcasecmp(str, "medium") == 0) return PRIORITY_MEDIUM;
+  if(strcasecmp(str, "high") == 0) return PRIORITY_HIGH;
+  return -1;
+}
+
+double 
+bench_now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void 
+bench_query(const char* src, uint32_t count) {
+  char err[128];
+  query_node* root = query_parse(src, err, sizeof(err));
+  if(!root) {
+    printf("todo: invalid query: %s\n", err);
+    return;
+  }
+
+  entries_da da;
+  tag_table tags;
+  entries_da_init(&da);
+  gen_synthetic_entries(&da, &tags, count, false);
+
+  query_program prog = {0};
+  double compile_start = bench_now_ms();
+  query_emit_node(&prog, root, &tags);
+  double compile_ms = bench_now_ms() - compile_start;
+
+  // Best of a few runs for both evaluators
+  const uint32_t runs = 5;
+  double compiled_ms = 0.0, interpreted_ms = 0.0;
+  uint32_t compiled_matches = 0, interpreted_matches = 0;
+  for(uint32_t run = 0; run < runs; run++) {
+    double start = bench_now_ms();
+    compiled_matches = 0;
+    for(uint32_t i = 0; i < da.count; i++) {
+      compiled_matches += query_eval(&prog, da.entries[i]);
+    }
+    double ms = bench_now_ms() - start;
+    if(!run || ms < compiled_ms) compiled_ms = ms;
+
+    start = bench_now_ms();
+    interpreted_matches = 0;
+    for(uint32_t i = 0; i < da.count; i++) {
+      interpreted_matches += query_interpret(root, da.entries[i], &tags);
+    }
+    ms = bench_now_ms() - start;
+    if(!run || ms < interpreted_ms) interpreted_ms = ms;
+  }
+
+  printf("======== Query Benchmark ========\n");
+  printf("query:       %s\n", src);
+  printf("entries:     %u (best of %u runs)\n", count, runs);
+  printf("compile:     %.4f ms (%u instructions)\n", compile_ms, prog.count);
+  printf("compiled:    %8.2f ms  %6.2f ns/entry  %u matches\n", 
+         compiled_ms, compiled_ms * 1e6 / (count ? count : 1), compiled_matches);
+  printf("interpreted: %8.2f ms  %6.2f ns/entry  %u matches\n", 
+         interpreted_ms, interpreted_ms * 1e6 / (count ? count : 1), interpreted_matches);
+  printf("speedup:     %.2fx\n", compiled_ms > 0.0 ? interpreted_ms / compiled_ms : 0.0);
+  printf("=================================\n");
+
+  query_free(&prog);
+  query_free_tree(root);
+  entries_da_free(&da, true);
+}
+
+char* 
+get_command_output(const char* cmd, mem_category category) {
+    FILE *fp;
+    char buffer[1024];
+    char *result = NULL;
+    size_t result_size = 0;
+
+    // Opening a new pipe with the fiven command
+    fp = popen(cmd, "r");
+    if (fp == NULL) {
+        printf("Failed to run command\n");
+        return NULL;
+    }
+
+    // Reading the output
+    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+        size_t buffer_len = strlen(buffer);
+        char *temp = mem_realloc(category, result, result_size + buffer_len + 1);
+        if (temp == NULL) {
+            printf("Memory allocation failed\n");
+            mem_free(result);
+            pclose(fp);
+            return NULL;
+        }
+        result = temp;
+        strcpy(result + result_size, buffer);
+        result_size += buffer_len;
+    }
+    pclose(fp);
+    return result;
+}
+
+void 
+serialize_todo_entry(FILE* file, todo_entry* entry) {
+  // Write completed to file
+  fwrite(&entry->completed, sizeof(bool), 1, file);
+
+  // Write description to file
+  size_t desc_len = strlen(entry->desc) + 1; // +1 for null terminator
+  // Writing the description length to the file for later 
+  // deserialization
+  fwrite(&desc_len, sizeof(size_t), 1, file);
+  fwrite(entry->desc, sizeof(char), desc_len, file);
+
+  // Write date to file
+  size_t date_len = strlen(entry->date) + 1; // +1 for null terminator
+  // Writing the date length to the file for later 
+  // deserialization
+  fwrite(&date_len, sizeof(size_t), 1, file);
+  fwrite(entry->date, sizeof(char), date_len, file);
+
+  // Write priority to file
+  fwrite(&entry->priority, sizeof(entry_priority), 1, file);
+
+  // Write tag mask to file
+  fwrite(&entry->tags, sizeof(uint64_t), 1, file);
+
+  // Write due date to file
+  fwrite(&entry->due, sizeof(int64_t), 1, file);
+
+  // Write position in the task tree to file
+  fwrite(&entry->depth, sizeof(uint32_t), 1, file);
+  fwrite(&entry->collapsed, sizeof(bool), 1, file);
+
+  // Write id & sequence numbers of the fields to file
+  fwrite(&entry->id, sizeof(uint64_t), 1, file);
+  fwrite(entry->seqs, sizeof(entry->seqs), 1, file);
+
+  // Write where the notes are in the notes region to file
+  fwrite(&entry->note_offset, sizeof(uint64_t), 1, file);
+  fwrite(&entry->note_size, sizeof(uint32_t), 1, file);
+}
+
+bool
+serialize_todo_list(const char* filename, entries_da* da, tag_table* tags, uint64_t seq) {
+  // The notes region between the header & the entries is kept 
+  // as it is, only the header & the entries are rewritten.
+  FILE* file;
+  list_header header;
+  tag_table oldtags;
+  uint64_t notes_size = 0;
+  if(open_todo_list(filename, &file, &oldtags, &header)) {
+    notes_size = header.notes_size;
+    fclose(file);
+  }
+  file = fopen(filename, notes_size ? "r+b" : "wb");
+  if(!file) {
+    printf("Failed to open data file.\n");
+    return false;
+  }
+  write_list_header(file, da->count, tags, seq, notes_size);
+  fseek(file, (long)notes_size, SEEK_CUR);
+
+  for(uint32_t i = 0; i < da->count; i++) {
+    serialize_todo_entry(file, da->entries[i]);
+  }
+  // Cutting off what is left of the entries written before
+  bool ok = fflush(file) == 0 && !ferror(file) && 
+    (!notes_size || ftruncate(fileno(file), ftell(file)) == 0);
+  if(fclose(file) != 0 || !ok) {
+    printf("Failed to write data file.\n");
+    return false;
+  }
+  return true;
+}
+
+void 
+write_list_header(FILE* file, uint32_t count, tag_table* tags, uint64_t seq, uint64_t notes_size) {
+  // The tag table has a fixed size so it can be 
+  // patched without rewriting the entries.
+  uint32_t version = DATA_FORMAT_VERSION;
+  fwrite(DATA_MAGIC, sizeof(char), 4, file);
+  fwrite(&version, sizeof(uint32_t), 1, file);
+  fwrite(&count, sizeof(uint32_t), 1, file);
+  fwrite(tags->names, sizeof(tags->names), 1, file);
+  fwrite(&seq, sizeof(uint64_t), 1, file);
+  // The size of the notes region is the last field of the header
+  fwrite(&notes_size, sizeof(uint64_t), 1, file);
+}
+
+bool 
+copy_bytes(FILE* in, FILE* out, uint64_t size) {
+  char chunk[EXCHANGE_IO_BUF_SIZE];
+  while(size) {
+    size_t n = size < sizeof(chunk) ? (size_t)size : sizeof(chunk);
+    if(fread(chunk, 1, n, in) != n || fwrite(chunk, 1, n, out) != n) {
+      return false;
+    }
+    size -= n;
+  }
+  return true;
+}
+
+todo_entry*  
+deserialize_todo_entry(FILE* file, uint32_t version, bool with_desc) {
+  // Allocate entry
+  todo_entry *entry = mem_alloc(MEM_ENTRIES, sizeof(todo_entry));
+  init_entry(entry);
+
+  // Read if entry is completed
+  if (fread(&entry->completed, sizeof(bool), 1, file) != 1) {
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Read the length of the description
+  size_t desc_len;
+  if (fread(&desc_len, sizeof(size_t), 1, file) != 1) {
+    mem_free(entry);
+    return NULL;
+  }
+
+  // The description is skipped if it isn't needed (--stats)
+  if (!with_desc) {
+    entry->desc = NULL;
+    if (fseek(file, (long)desc_len, SEEK_CUR) != 0) {
+      mem_free(entry);
+      return NULL;
+    }
+  } else {
+    // Allocating space to store the entries description
+    entry->desc = mem_alloc(MEM_DESCRIPTIONS, desc_len);
+    if (!entry->desc) {
+      mem_free(entry);
+      return NULL;
+    }
+    // Read the description from the file
+    if (fread(entry->desc, sizeof(char), desc_len, file) != desc_len) {
+      mem_free(entry->desc);
+      mem_free(entry);
+      return NULL;
+    }
+  }
+
+  // Read the date length from the file
+  size_t date_len;
+  if (fread(&date_len, sizeof(size_t), 1, file) != 1) {
+    mem_free(entry->desc);
+    mem_free(entry);
+    return NULL;
+  }
+  // Allocating space for the date
+  entry->date = mem_alloc(MEM_DATES, date_len);
+  if (!entry->date) {
+    mem_free(entry->desc);
+    mem_free(entry);
+    return NULL;
+  }
+  // Reading the date string
+  if (fread(entry->date, sizeof(char), date_len, file) != date_len) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Reading the entires priority
+  if (fread(&entry->priority, sizeof(entry_priority), 1, file) != 1) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Reading the tag mask, files without a header have no tags
+  entry->tags = 0;
+  if (version >= 1 && fread(&entry->tags, sizeof(uint64_t), 1, file) != 1) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Reading the due date
+  if (version >= 2 && fread(&entry->due, sizeof(int64_t), 1, file) != 1) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Reading the position in the task tree, older files are flat
+  if (version >= 3 && (fread(&entry->depth, sizeof(uint32_t), 1, file) != 1 || 
+                       fread(&entry->collapsed, sizeof(bool), 1, file) != 1)) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Reading the id & sequence numbers, older files get them when loaded
+  if (version >= 4 && (fread(&entry->id, sizeof(uint64_t), 1, file) != 1 || 
+                       fread(entry->seqs, sizeof(entry->seqs), 1, file) != 1)) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  // Reading where the notes are, the notes themselves are read on demand
+  if (version >= 5 && (fread(&entry->note_offset, sizeof(uint64_t), 1, file) != 1 || 
+                       fread(&entry->note_size, sizeof(uint32_t), 1, file) != 1)) {
+    mem_free(entry->desc);
+    mem_free(entry->date);
+    mem_free(entry);
+    return NULL;
+  }
+
+  return entry;
+}
+bool 
+open_todo_list(const char* filename, FILE** file, tag_table* tags, list_header* header) {
+  // Opens a data file & reads its header, the file is left at the first entry
+  *file = fopen(filename, "rb");
+  if(!*file) {
+    // If file does not exist, create it 
+    *file = fopen(filename, "w");
+    if(*file) fclose(*file);
+    *file = fopen(filename, "rb");
+  }
+  if(!*file) {
+    printf("Failed to open data file.\n");
+    return false;
+  }
+
+  // Reading the header. Files written before the header 
+  // existed start right with the first entry.
+  memset(header, 0, sizeof(*header));
+  char magic[4];
+  memset(tags, 0, sizeof(*tags));
+  if(fread(magic, sizeof(char), 4, *file) == 4 && memcmp(magic, DATA_MAGIC, 4) == 0) {
+    if(fread(&header->version, sizeof(uint32_t), 1, *file) != 1 ||
+       fread(&header->count, sizeof(uint32_t), 1, *file) != 1 ||
+       fread(tags->names, sizeof(tags->names), 1, *file) != 1 || 
+       (header->version >= 4 && fread(&header->seq, sizeof(uint64_t), 1, *file) != 1) ||
+       (header->version >= 5 && fread(&header->notes_size, sizeof(uint64_t), 1, *file) != 1)) {
+      printf("Failed to read data file header.\n");
+      fclose(*file);
+      return false;
+    }
+    if(header->version > DATA_FORMAT_VERSION) {
+      printf("Data file was written by a newer version of todo.\n");
+      fclose(*file);
+      return false;
+    }
+    // Dropped tags leave empty slots behind
+    for(uint32_t i = 0; i < MAX_TAGS; i++) {
+      if(tags->names[i][0]) tags->count = i + 1;
+    }
+    // The notes are skipped, they are only read when they are shown
+    header->notes_start = ftell(*file);
+    if(fseek(*file, (long)header->notes_size, SEEK_CUR) != 0) {
+      printf("Failed to read data file header.\n");
+      fclose(*file);
+      return false;
+    }
+  } else {
+    rewind(*file);
+  }
+  return true;
+}
+
+void deserialize_todo_list(const char* filename, entries_da* da, tag_table* tags, uint64_t* seq) {
+  FILE* file;
+  list_header header;
+  if(!open_todo_list(filename, &file, tags, &header)) {
+    return;
+  }
+  if(header.count > da->cap) {
+    entries_da_resize(da, header.count);
+  }
+
+  todo_entry *entry;
+  while ((entry = deserialize_todo_entry(file, header.version, true)) != NULL) {
+    entries_da_push(da, entry);
+  }
+  fclose(file);
+  init_tree(da);
+
+  // Entries in the undo & redo logs are in the format of the file 
+  if(header.version < DATA_FORMAT_VERSION) {
+    clear_op_logs();
+  }
+
+  // Entries of files written before syncing existed are 
+  // given their ids, as a single change.
+  *seq = header.seq;
+  bool upgraded = false;
+  for(uint32_t i = 0; i < da->count; i++) {
+    todo_entry* e = da->entries[i];
+    if(e->id) continue;
+    e->id = new_entry_id();
+    for(uint32_t f = 0; f < SYNC_FIELD_COUNT; f++) {
+      e->seqs[f] = header.seq + 1;
+    }
+    upgraded = true;
+  }
+  *seq += upgraded;
+}
+
+bool 
+save_todo_list() {
+  // The counts in the manifest are only updated once the list is saved
+  drop_unused_tags();
+  s.save_failed = !serialize_todo_list(s.tododata_file, &s.todo_entries, &s.tags, s.seq);
+  if(s.save_failed) {
+    return false;
+  }
+  save_stats();
+  update_list_counts();
+  if(s.input.mode == INPUT_LIVE) {
+    save_manifest();
+  }
+  return true;
+}
+
+void 
+update_list_counts() {
+  todo_list* list = &s.lists[s.crnt_list];
+  list->count = s.stats.count;
+  list->completed = s.stats.completed;
+}
+
+bool 
+load_note(const todo_entry* entry, exchange_buf* buf) {
+  // Reading the notes of a single task from the notes region
+  buf->len = 0;
+  exchange_buf_reserve(buf, entry->note_size + 1);
+  buf->data[0] = '\0';
+  if(!entry->note_size) return true;
+
+  FILE* file;
+  list_header header;
+  tag_table tags;
+  if(!open_todo_list(s.tododata_file, &file, &tags, &header)) {
+    return false;
+  }
+  bool ok = entry->note_offset + entry->note_size <= header.notes_size && 
+    fseek(file, header.notes_start + (long)entry->note_offset, SEEK_SET) == 0 &&
+    fread(buf->data, 1, entry->note_size, file) == entry->note_size;
+  fclose(file);
+  if(!ok) {
+    printf("todo: failed to read the notes of '%s'.\n", entry->desc);
+    return false;
+  }
+  buf->len = entry->note_size;
+  buf->data[buf->len] = '\0';
+  return true;
+}
+
+bool 
+set_note(todo_entry* entry, const char* text, uint32_t len) {
+  // The notes region is copied to a new data file with the new notes 
+  // appended, replaced notes are left behind until the region is compacted.
+  FILE* in;
+  list_header header;
+  tag_table tags;
+  if(!open_todo_list(s.tododata_file, &in, &tags, &header)) {
+    return false;
+  }
+  char tmppath[sizeof(s.tododata_file) + 16];
+  snprintf(tmppath, sizeof(tmppath), "%s.note", s.tododata_file);
+  FILE* out = fopen(tmppath, "wb");
+  if(!out) {
+    printf("todo: failed to write '%s'.\n", tmppath);
+    fclose(in);
+    return false;
+  }
+  uint64_t notes_size = header.notes_size + len;
+  write_list_header(out, s.todo_entries.count, &s.tags, s.seq, notes_size);
+  bool ok = !header.notes_size || (fseek(in, header.notes_start, SEEK_SET) == 0 && 
+    copy_bytes(in, out, header.notes_size));
+  ok = ok && (!len || fwrite(text, 1, len, out) == len);
+  fclose(in);
+
+  uint64_t note_offset = entry->note_offset;
+  uint32_t note_size = entry->note_size;
+  entry->note_offset = len ? header.notes_size : 0;
+  entry->note_size = len;
+  if(!replace_list_file(out, tmppath, ok)) {
+    entry->note_offset = note_offset;
+    entry->note_size = note_size;
+    return false;
+  }
+
+  uint64_t live = 0;
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    live += s.todo_entries.entries[i]->note_size;
+  }
+  if(notes_size > NOTES_COMPACT_MIN_SIZE && notes_size > live * 2) {
+    return compact_notes();
+  }
+  return true;
+}
+
+bool 
+compact_notes() {
+  // Rewriting the notes region with only the notes that are still used. 
+  // Removed tasks in the undo log may refer to dropped notes, 
+  // so the undo & redo logs are cleared.
+  FILE* in;
+  list_header header;
+  tag_table tags;
+  if(!open_todo_list(s.tododata_file, &in, &tags, &header)) {
+    return false;
+  }
+  char tmppath[sizeof(s.tododata_file) + 16];
+  snprintf(tmppath, sizeof(tmppath), "%s.compact", s.tododata_file);
+  FILE* out = fopen(tmppath, "wb");
+  if(!out) {
+    printf("todo: failed to write '%s'.\n", tmppath);
+    fclose(in);
+    return false;
+  }
+  uint64_t size = 0;
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    size += s.todo_entries.entries[i]->note_size;
+  }
+  write_list_header(out, s.todo_entries.count, &s.tags, s.seq, size);
+  bool ok = true;
+  for(uint32_t i = 0; i < s.todo_entries.count && ok; i++) {
+    todo_entry* entry = s.todo_entries.entries[i];
+    if(!entry->note_size) continue;
+    ok = fseek(in, header.notes_start + (long)entry->note_offset, SEEK_SET) == 0 && 
+      copy_bytes(in, out, entry->note_size);
+  }
+  fclose(in);
+
+  // The entries are written with the offsets of their notes in the 
+  // new region, the old offsets are kept in case that fails.
+  uint64_t* offsets = mem_alloc(MEM_ARRAYS, (s.todo_entries.count + 1) * sizeof(uint64_t));
+  uint64_t offset = 0;
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    todo_entry* entry = s.todo_entries.entries[i];
+    offsets[i] = entry->note_offset;
+    if(!entry->note_size) continue;
+    entry->note_offset = offset;
+    offset += entry->note_size;
+  }
+  ok = replace_list_file(out, tmppath, ok);
+  if(!ok) {
+    for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+      s.todo_entries.entries[i]->note_offset = offsets[i];
+    }
+  }
+  mem_free(offsets);
+  if(ok) {
+    clear_op_logs();
+  }
+  return ok;
+}
+
+bool 
+replace_list_file(FILE* out, const char* tmppath, bool ok) {
+  // Writing the entries after the notes region & replacing the data file
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    serialize_todo_entry(out, s.todo_entries.entries[i]);
+  }
+  ok = ok && fflush(out) == 0 && !ferror(out);
+  if(fclose(out) != 0 || !ok || rename(tmppath, s.tododata_file) != 0) {
+    printf("todo: failed to write '%s'.\n", s.tododata_file);
+    remove(tmppath);
+    return false;
+  }
+  return true;
+}
+
+void 
+open_notes(todo_entry* entry) {
+  // Only the notes of the expanded task are loaded
+  if(!load_note(entry, &s.notes_buf)) return;
+  s.notes_entry = entry;
+  s.notes_input.selected = false;
+  s.notes_input.cursor_index = 0;
+}
+
+void 
+close_notes() {
+  // Unsaved changes are dropped, the buffer is kept for the next notes
+  s.notes_entry = NULL;
+  s.notes_input.selected = false;
+  if(s.notes_buf.data) {
+    s.notes_buf.data[0] = '\0';
+  }
+  s.notes_buf.len = 0;
+}
+
+bool 
+print_notes(uint32_t i) {
+  todo_entry* entry = s.todo_entries.entries[i];
+  exchange_buf buf = {0};
+  if(!load_note(entry, &buf)) {
+    mem_free(buf.data);
+    return false;
+  }
+  char* priorities_str[] = {
+    "L", "M", "H"
+  };
+  printf("======== Task %u ========\n", i);
+  printf("(%s) [%c]: %s\n", priorities_str[entry->priority], entry->completed ? 'x' : ' ', entry->desc);
+  // Dates created with DATE_CMD end with a line break
+  printf("Created: %.*s\n", (int)strcspn(entry->date, "\n"), entry->date);
+  if(buf.len) {
+    printf("\n%s%s", buf.data, buf.data[buf.len - 1] == '\n' ? "" : "\n");
+  } else {
+    printf("\nThis task has no notes.\n");
+  }
+  printf("========================\n");
+  mem_free(buf.data);
+  return true;
+}
+
+void 
+load_manifest() {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s/%s", TODO_DATA_DIR, TODO_LISTS_DIR, TODO_MANIFEST_FILE);
+
+  s.nlists = 0;
+  s.active_list = 0;
+
+  FILE* file = fopen(path, "r");
+  if(file) {
+    // First line holds the active list, every other 
+    // line holds the counts and name of one list.
+    char active[LIST_NAME_SIZE] = {0};
+    if(fscanf(file, "active %63[^\n]\n", active) != 1) {
+      active[0] = '\0';
+    }
+    todo_list list;
+    while(s.nlists < MAX_LISTS && 
+      fscanf(file, "%u %u %63[^\n]\n", &list.count, &list.completed, list.name) == 3) {
+      if(strcmp(list.name, active) == 0) {
+        s.active_list = s.nlists;
+      }
+      s.lists[s.nlists++] = list;
+    }
+    fclose(file);
+  }
+
+  // The default list always exists and maps to TODO_DATA_FILE
+  if(find_list(DEFAULT_LIST_NAME) == -1) {
+    if(s.nlists == MAX_LISTS) s.nlists--;
+    memmove(&s.lists[1], &s.lists[0], s.nlists * sizeof(todo_list));
+    memset(&s.lists[0], 0, sizeof(todo_list));
+    strcpy(s.lists[0].name, DEFAULT_LIST_NAME);
+    s.nlists++;
+    s.active_list = 0;
+  }
+  s.crnt_list = s.active_list;
+}
+
+void 
+save_manifest() {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", TODO_DATA_DIR, TODO_LISTS_DIR);
+  mkdir(path, 0755);
+  snprintf(path, sizeof(path), "%s/%s/%s", TODO_DATA_DIR, TODO_LISTS_DIR, TODO_MANIFEST_FILE);
+
+  FILE* file = fopen(path, "w");
+  if(!file) {
+    printf("Failed to open list manifest.\n");
+    return;
+  }
+  fprintf(file, "active %s\n", s.lists[s.active_list].name);
+  for(uint32_t i = 0; i < s.nlists; i++) {
+    fprintf(file, "%u %u %s\n", s.lists[i].count, s.lists[i].completed, s.lists[i].name);
+  }
+  fclose(file);
+}
+
+bool 
+list_data_path(const char* name, char* path, size_t size) {
+  // Lists other than the default one are kept in TODO_LISTS_DIR, 
+  // which is created before any of them is read or written.
+  int32_t len;
+  if(strcmp(name, DEFAULT_LIST_NAME) == 0) {
+    len = snprintf(path, size, "%s/%s", TODO_DATA_DIR, TODO_DATA_FILE);
+  } else {
+    len = snprintf(path, size, "%s/%s", TODO_DATA_DIR, TODO_LISTS_DIR);
+    if(len > 0 && (size_t)len < size && mkdir(path, 0755) != 0 && errno != EEXIST) {
+      printf("todo: failed to create '%s'.\n", path);
+      return false;
+    }
+    len = snprintf(path, size, "%s/%s/%s", TODO_DATA_DIR, TODO_LISTS_DIR, name);
+  }
+  if(len < 0 || (size_t)len >= size) {
+    printf("todo: the path of list '%s' is too long.\n", name);
+    return false;
+  }
+  return true;
+}
+
+int32_t 
+find_list(const char* name) {
+  for(uint32_t i = 0; i < s.nlists; i++) {
+    if(strcmp(s.lists[i].name, name) == 0) return i;
+  }
+  return -1;
+}
+
+int32_t 
+add_list(const char* name) {
+  if(!valid_list_name(name)) {
+    printf("todo: invalid list name: '%s'.\n", name);
+    return -1;
+  }
+  if(s.nlists == MAX_LISTS) {
+    printf("todo: cannot create more than %i lists.\n", MAX_LISTS);
+    return -1;
+  }
+  char path[sizeof(s.tododata_file)];
+  if(!list_data_path(name, path, sizeof(path))) {
+    return -1;
+  }
+  todo_list* list = &s.lists[s.nlists];
+  memset(list, 0, sizeof(*list));
+  strcpy(list->name, name);
+  return s.nlists++;
+}
+
+bool 
+valid_list_name(const char* name) {
+  size_t len = strlen(name);
+  if(!len || len >= LIST_NAME_SIZE || strcmp(name, TODO_MANIFEST_FILE) == 0) {
+    return false;
+  }
+  // Dots would collide with the files kept next to a list
+  for(size_t i = 0; i < len; i++) {
+    if(name[i] == '/' || name[i] == '.' || !isprint((unsigned char)name[i])) return false;
+  }
+  return true;
+}
+
+bool 
+switch_list(uint32_t idx) {
+  char path[sizeof(s.tododata_file)];
+  if(!list_data_path(s.lists[idx].name, path, sizeof(path))) {
+    return false;
+  }
+
+  // Freeing the entries of the list we leave
+  close_notes();
+  entries_da_free(&s.todo_entries, true);
+
+  // Tags are per list
+  memset(&s.tags, 0, sizeof(s.tags));
+  s.crnt_filter.tags = 0;
+
+  s.crnt_list = idx;
+  s.active_list = idx;
+  strcpy(s.tododata_file, path);
+  entries_da_init(&s.todo_entries);
+  deserialize_todo_list(s.tododata_file, &s.todo_entries, &s.tags, &s.seq);
+  load_stats();
+  init_deadlines();
+  remind_overdue();
+  index_invalidate();
+  update_list_counts();
+  save_manifest();
+  return true;
+}
+
+void 
+print_lists() {
+  printf("======== Your Lists ========\n");
+  for(uint32_t i = 0; i < s.nlists; i++) {
+    printf("%c %s (%u tasks, %u done)\n", i == s.active_list ? '*' : ' ', 
+           s.lists[i].name, s.lists[i].count, s.lists[i].completed);
+  }
+  printf("============================\n");
+}
+
+bool 
+select_list() {
+  load_manifest();
+
+  // Selecting the list given on the command line, creating it 
+  // if it does not exist yet.
+  if(s.requested_list) {
+    int32_t idx = find_list(s.requested_list);
+    if(idx == -1) {
+      idx = add_list(s.requested_list);
+    }
+    if(idx == -1) {
+      return false;
+    }
+    s.crnt_list = idx;
+  }
+  return list_data_path(s.lists[s.crnt_list].name, s.tododata_file, sizeof(s.tododata_file));
+}
+
+int32_t 
+parse_exchange_format(const char* name, const char* path) {
+  // Without an explicit format it is derived from the file extension
+  if(!name) {
+    name = strrchr(path, '.');
+    if(!name) return -1;
+    name++;
+  }
+  if(strcasecmp(name, "csv") == 0) return FORMAT_CSV;
+  if(strcasecmp(name, "jsonl") == 0 || strcasecmp(name, "json") == 0 || 
+     strcasecmp(name, "ndjson") == 0) return FORMAT_JSONL;
+  if(strcasecmp(name, "todotxt") == 0 || strcasecmp(name, "txt") == 0) return FORMAT_TODOTXT;
+  return -1;
+}
+
+import_field 
+map_import_field(const char* name) {
+  static const struct { const char* name; import_field field; } fields[] = {
+    {"description", FIELD_DESC}, {"desc", FIELD_DESC}, {"title", FIELD_DESC}, {"summary", FIELD_DESC}, 
+    {"task", FIELD_DESC}, {"name", FIELD_DESC}, {"text", FIELD_DESC},
+    {"done", FIELD_DONE}, {"completed", FIELD_DONE}, {"complete", FIELD_DONE}, {"status", FIELD_DONE}, 
+    {"state", FIELD_DONE}, {"closed", FIELD_DONE},
+    {"priority", FIELD_PRIORITY}, {"prio", FIELD_PRIORITY}, {"importance", FIELD_PRIORITY}, {"severity", FIELD_PRIORITY},
+    {"tags", FIELD_TAGS}, {"tag", FIELD_TAGS}, {"labels", FIELD_TAGS}, {"label", FIELD_TAGS},
+    {"due", FIELD_DUE}, {"due_date", FIELD_DUE}, {"duedate", FIELD_DUE}, {"deadline", FIELD_DUE},
+    {"created", FIELD_DATE}, {"created_at", FIELD_DATE}, {"creation_date", FIELD_DATE}, {"date", FIELD_DATE},
+    {"depth", FIELD_DEPTH}
+  };
+  // Names are compared lower case, with spaces & dashes as underscores
+  char key[32];
+  size_t len = 0;
+  while(isspace((unsigned char)*name)) name++;
+  for(; *name && len + 1 < sizeof(key); name++) {
+    key[len++] = (*name == ' ' || *name == '-') ? '_' : tolower((unsigned char)*name);
+  }
+  while(len && key[len - 1] == '_') len--;
+  key[len] = '\0';
+  for(uint32_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if(strcmp(key, fields[i].name) == 0) return fields[i].field;
+  }
+  return FIELD_IGNORE;
+}
+
+entry_priority 
+map_priority(const char* str) {
+  // Mapping the priority schemes of common trackers onto ours. 
+  // Numbers are ranks (1 is the most important), letters are 
+  // todo.txt priorities.
+  while(isspace((unsigned char)*str) || *str == '(') str++;
+  if(!*str) return PRIORITY_LOW;
+  static const char* high[] = {
+    "high", "h", "a", "urgent", "critical", "blocker", "highest", "p0", "p1", "0", "1"
+  };
+  static const char* medium[] = {
+    "medium", "med", "m", "b", "normal", "moderate", "major", "p2", "2"
+  };
+  size_t len = strlen(str);
+  while(len && (isspace((unsigned char)str[len - 1]) || str[len - 1] == ')')) len--;
+  for(uint32_t i = 0; i < sizeof(high) / sizeof(high[0]); i++) {
+    if(strlen(high[i]) == len && strncasecmp(str, high[i], len) == 0) return PRIORITY_HIGH;
+  }
+  for(uint32_t i = 0; i < sizeof(medium) / sizeof(medium[0]); i++) {
+    if(strlen(medium[i]) == len && strncasecmp(str, medium[i], len) == 0) return PRIORITY_MEDIUM;
+  }
+  return PRIORITY_LOW;
+}
+
+bool 
+map_done(const char* str) {
+  while(isspace((unsigned char)*str)) str++;
+  static const char* done[] = {
+    "x", "1", "y", "yes", "true", "done", "completed", "complete", "closed", "resolved", "finished", "fixed"
+  };
+  for(uint32_t i = 0; i < sizeof(done) / sizeof(done[0]); i++) {
+    if(strcasecmp(str, done[i]) == 0) return true;
+  }
+  return false;
+}
+
+bool 
+parse_import_tm(const char* str, bool end_of_day, struct tm* tm) {
+  // Unix timestamps, our own format & ISO 8601 dates. Dates without 
+  // a time are at the end of the day if end_of_day is set.
+  while(isspace((unsigned char)*str)) str++;
+  if(!*str) return false;
+  char* end;
+  long long ts = strtoll(str, &end, 10);
+  if(*end == '\0') {
+    time_t t = (time_t)ts;
+    return ts > 0 && localtime_r(&t, tm);
+  }
+
+  static const char* formats[] = {
+    "%d.%m.%Y, %H:%M", "%d.%m.%Y %H:%M", "%d.%m.%Y", 
+    "%Y-%m-%dT%H:%M:%S", "%Y-%m-%dT%H:%M", "%Y-%m-%d %H:%M", "%Y-%m-%d"
+  };
+  for(uint32_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    memset(tm, 0, sizeof(*tm));
+    bool date_only = i == 2 || i == 6;
+    if(date_only && end_of_day) {
+      tm->tm_hour = 23;
+      tm->tm_min = 59;
+    }
+    const char* rest = strptime(str, formats[i], tm);
+    // Trailing time zones & fractions of seconds are ignored
+    if(rest && (*rest == '\0' || (i >= 3 && strchr("Z+-.", *rest)))) {
+      tm->tm_isdst = -1;
+      return true;
+    }
+  }
+  return false;
+}
+
+int64_t 
+import_due(import_ctx* ctx, const char* str) {
+  // Exports tend to repeat dates, so the last conversion is reused 
+  if(strncmp(str, ctx->due_key, sizeof(ctx->due_key)) != 0) {
+    struct tm tm;
+    ctx->due_value = parse_import_tm(str, true, &tm) ? (int64_t)mktime(&tm) : 0;
+    snprintf(ctx->due_key, sizeof(ctx->due_key), "%s", str);
+  }
+  return ctx->due_value;
+}
+
+void 
+exchange_buf_push(exchange_buf* buf, char c) {
+  if(buf->len == buf->cap) {
+    uint32_t new_cap = buf->cap ? buf->cap * 2 : EXCHANGE_BUF_INIT_CAP;
+    char* temp = (char*)mem_realloc(MEM_ARRAYS, buf->data, new_cap);
+    if (!temp) {
+      fprintf(stderr, "Failed to reallocate memory\n");
+      exit(EXIT_FAILURE);
+    }
+    buf->data = temp;
+    buf->cap = new_cap;
+  }
+  buf->data[buf->len++] = c;
+}
+
+void 
+exchange_buf_reserve(exchange_buf* buf, uint32_t n) {
+  // Making room for n more bytes
+  if(buf->len + n <= buf->cap) return;
+  uint32_t new_cap = buf->cap ? buf->cap : EXCHANGE_BUF_INIT_CAP;
+  while(new_cap < buf->len + n) {
+    new_cap *= 2;
+  }
+  char* temp = (char*)mem_realloc(MEM_ARRAYS, buf->data, new_cap);
+  if (!temp) {
+    fprintf(stderr, "Failed to reallocate memory\n");
+    exit(EXIT_FAILURE);
+  }
+  buf->data = temp;
+  buf->cap = new_cap;
+}
+
+bool 
+read_line(FILE* file, exchange_buf* buf) {
+  // Reads a line without its line ending into buf 
+  buf->len = 0;
+  int c;
+  while((c = getc_unlocked(file)) != EOF && c != '\n') {
+    exchange_buf_push(buf, (char)c);
+  }
+  if(buf->len && buf->data[buf->len - 1] == '\r') buf->len--;
+  exchange_buf_push(buf, '\0');
+  return c != EOF || buf->len > 1;
+}
+
+void 
+skip_utf8_bom(FILE* file) {
+  // Spreadsheet applications start UTF-8 files with a byte order mark. Only
+  // one byte can be pushed back, on a partial match the bytes read before are 
+  // dropped, which doesn't matter as no field name starts with them.
+  int c = fgetc(file);
+  if(c == 0xEF && (c = fgetc(file)) == 0xBB && (c = fgetc(file)) == 0xBF) return;
+  if(c != EOF) ungetc(c, file);
+}
+
+int32_t 
+csv_read_record(FILE* file, exchange_buf* buf, uint32_t* fields, uint32_t maxfields) {
+  // Reads one record into buf, every field is null terminated and 
+  // fields holds their offsets. Quoted fields may contain separators, 
+  // line breaks & quotes written as "". Returns -1 at the end.
+  buf->len = 0;
+  uint32_t nfields = 0;
+  int c = getc_unlocked(file);
+  if(c == EOF) return -1;
+  for(;;) {
+    if(nfields < maxfields) fields[nfields] = buf->len;
+    nfields++;
+    if(c == '"') {
+      while((c = getc_unlocked(file)) != EOF) {
+        if(c == '"') {
+          c = getc_unlocked(file);
+          if(c != '"') break;
+        }
+        exchange_buf_push(buf, (char)c);
+      }
+    }
+    // Unquoted data (or anything after a closing quote) up to the separator
+    while(c != EOF && c != ',' && c != '\n') {
+      if(c != '\r') exchange_buf_push(buf, (char)c);
+      c = getc_unlocked(file);
+    }
+    exchange_buf_push(buf, '\0');
+    if(c != ',') break;
+    c = getc_unlocked(file);
+  }
+  return nfields < maxfields ? nfields : maxfields;
+}
+
+char* 
+json_parse_string(char** p) {
+  // Decodes the string at *p (after the opening quote) in place
+  char* out = *p, *str = *p;
+  char* in = *p;
+  while(*in && *in != '"') {
+    if(*in != '\\') {
+      *out++ = *in++;
+      continue;
+    }
+    in++;
+    switch(*in) {
+      case 'n': *out++ = '\n'; in++; break;
+      case 't': *out++ = '\t'; in++; break;
+      case 'r': *out++ = '\r'; in++; break;
+      case 'b': *out++ = '\b'; in++; break;
+      case 'f': *out++ = '\f'; in++; break;
+      case 'u': {
+        // Encoding the code point as UTF-8, surrogate pairs are not combined 
+        uint32_t cp = 0;
+        in++;
+        for(uint32_t i = 0; i < 4 && isxdigit((unsigned char)*in); i++, in++) {
+          cp = cp * 16 + (isdigit((unsigned char)*in) ? *in - '0' : (tolower((unsigned char)*in) - 'a' + 10));
+        }
+        if(cp < 0x80) {
+          *out++ = (char)cp;
+        } else if(cp < 0x800) {
+          *out++ = (char)(0xc0 | (cp >> 6));
+          *out++ = (char)(0x80 | (cp & 0x3f));
+        } else {
+          *out++ = (char)(0xe0 | (cp >> 12));
+          *out++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+          *out++ = (char)(0x80 | (cp & 0x3f));
+        }
+        break;
+      }
+      case '\0': break;
+      default: *out++ = *in++; break;
+    }
+  }
+  if(*in == '"') in++;
+  *out = '\0';
+  *p = in;
+  return str;
+}
+
+char* 
+json_parse_value(char** p, char* scratch, size_t size) {
+  // Returns the value at *p as text. Arrays of strings are joined with 
+  // commas (for tags), nested objects & other arrays are skipped.
+  char* in = *p;
+  while(isspace((unsigned char)*in)) in++;
+  char* value = NULL;
+  if(*in == '"') {
+    in++;
+    value = json_parse_string(&in);
+  } else if(*in == '[' || *in == '{') {
+    char* out = ++in;
+    value = out;
+    uint32_t depth = 1;
+    while(*in && depth) {
+      if(*in == '"') {
+        in++;
+        char* str = json_parse_string(&in);
+        if(depth == 1) {
+          if(out != value) *out++ = ',';
+          size_t len = strlen(str);
+          memmove(out, str, len);
+          out += len;
+        }
+      } else {
+        if(*in == '[' || *in == '{') depth++;
+        if(*in == ']' || *in == '}') depth--;
+        in++;
+      }
+    }
+    *out = '\0';
+  } else {
+    // Bare values are copied, terminating them in place would 
+    // overwrite the separator that follows.
+    size_t len = 0;
+    while(*in && *in != ',' && *in != '}' && *in != ']' && !isspace((unsigned char)*in)) {
+      if(len + 1 < size) scratch[len++] = *in;
+      in++;
+    }
+    scratch[len] = '\0';
+    value = scratch;
+    if(strcmp(value, "null") == 0 || strcmp(value, "false") == 0) value[0] = '\0';
+  }
+  *p = in;
+  return value;
+}
+
+void 
+apply_import_field(import_ctx* ctx, todo_entry* entry, import_field field, char* value) {
+  switch(field) {
+    case FIELD_DESC:      entry->desc = value; break;
+    case FIELD_DONE:      entry->completed = map_done(value); break;
+    case FIELD_PRIORITY:  entry->priority = map_priority(value); break;
+    case FIELD_DUE:       entry->due = import_due(ctx, value); break;
+    case FIELD_DATE:      entry->date = value; break;
+    case FIELD_DEPTH:     entry->depth = (uint32_t)atoi(value); break;
+    case FIELD_TAGS: {
+      // Tags may be separated by commas, semicolons or spaces
+      for(char* c = value; *c; c++) {
+        if(*c == ';' || *c == ' ' || *c == '#') *c = ',';
+      }
+      entry->tags |= parse_tags(&ctx->tags, value, true, &ctx->dropped_tags);
+      break;
+    }
+    default: break;
+  }
+}
+
+void 
+import_entry(import_ctx* ctx, todo_entry* entry) {
+  // Imported entries are written to one file per priority of their root 
+  // task, concatenating them afterwards sorts them by priority without 
+  // holding them in memory.
+  if((int64_t)entry->depth > ctx->depth + 1) {
+    entry->depth = ctx->depth + 1;
+  }
+  if(entry->depth == 0) {
+    ctx->root_priority = entry->priority;
+  }
+  ctx->depth = entry->depth;
+  if(!entry->id) {
+    entry->id = new_entry_id();
+    for(uint32_t i = 0; i < SYNC_FIELD_COUNT; i++) {
+      entry->seqs[i] = ctx->seq;
+    }
+  }
+  serialize_todo_entry(ctx->buckets[ctx->root_priority], entry);
+  ctx->count++;
+  ctx->completed += entry->completed;
+}
+
+void 
+import_record(import_ctx* ctx, todo_entry* entry) {
+  if(!entry->desc || !entry->desc[0]) {
+    ctx->skipped++;
+    return;
+  }
+  // Empty cells have no creation date, they must not match the empty initial key
+  if(entry->date && !entry->date[0]) entry->date = NULL;
+  // Creation dates are converted to the format of DATE_CMD
+  if(entry->date && strncmp(entry->date, ctx->date_key, sizeof(ctx->date_key)) != 0) {
+    struct tm tm;
+    if(parse_import_tm(entry->date, false, &tm)) {
+      strftime(ctx->entry_date, sizeof(ctx->entry_date), "%d.%m.%Y, %H:%M", &tm);
+    } else {
+      strcpy(ctx->entry_date, ctx->date);
+    }
+    snprintf(ctx->date_key, sizeof(ctx->date_key), "%s", entry->date);
+  }
+  entry->date = entry->date ? ctx->entry_date : ctx->date;
+  // Line breaks can't be displayed in the list
+  for(char* c = entry->desc; *c; c++) {
+    if(*c == '\n' || *c == '\r' || *c == '\t') *c = ' ';
+  }
+  import_entry(ctx, entry);
+  ctx->imported++;
+}
+
+void 
+import_csv(FILE* file, import_ctx* ctx) {
+  exchange_buf buf = {0};
+  uint32_t fields[IMPORT_MAX_FIELDS];
+  import_field columns[IMPORT_MAX_FIELDS];
+
+  skip_utf8_bom(file);
+  // The header maps the columns to fields 
+  int32_t ncolumns = csv_read_record(file, &buf, fields, IMPORT_MAX_FIELDS);
+  for(int32_t i = 0; i < ncolumns; i++) {
+    columns[i] = map_import_field(buf.data + fields[i]);
+  }
+
+  int32_t nfields;
+  while((nfields = csv_read_record(file, &buf, fields, IMPORT_MAX_FIELDS)) != -1) {
+    if(nfields == 1 && !buf.data[0]) continue; // Empty line
+    todo_entry entry;
+    init_entry(&entry);
+    entry.completed = false;
+    entry.priority = PRIORITY_LOW;
+    entry.tags = 0;
+    entry.desc = entry.date = NULL;
+    for(int32_t i = 0; i < nfields && i < ncolumns; i++) {
+      apply_import_field(ctx, &entry, columns[i], buf.data + fields[i]);
+    }
+    import_record(ctx, &entry);
+  }
+  mem_free(buf.data);
+}
+
+void 
+import_jsonl(FILE* file, import_ctx* ctx) {
+  exchange_buf buf = {0};
+  char scratch[64];
+  while(read_line(file, &buf)) {
+    char* p = buf.data;
+    while(isspace((unsigned char)*p)) p++;
+    if(*p != '{') {
+      if(*p) ctx->skipped++;
+      continue;
+    }
+    p++;
+
+    todo_entry entry;
+    init_entry(&entry);
+    entry.completed = false;
+    entry.priority = PRIORITY_LOW;
+    entry.tags = 0;
+    entry.desc = entry.date = NULL;
+    for(;;) {
+      while(isspace((unsigned char)*p) || *p == ',') p++;
+      if(*p != '"') break;
+      p++;
+      import_field field = map_import_field(json_parse_string(&p));
+      while(isspace((unsigned char)*p)) p++;
+      if(*p != ':') break;
+      p++;
+      char* value = json_parse_value(&p, scratch, sizeof(scratch));
+      apply_import_field(ctx, &entry, field, value);
+    }
+    import_record(ctx, &entry);
+  }
+  mem_free(buf.data);
+}
+
+void 
+import_todotxt(FILE* file, import_ctx* ctx) {
+  // x (A) 2024-01-01 2023-12-24 Description +tag @context due:2024-12-24
+  exchange_buf buf = {0};
+  while(read_line(file, &buf)) {
+    char* p = buf.data;
+    while(isspace((unsigned char)*p)) p++;
+    if(!*p) continue;
+
+    todo_entry entry;
+    init_entry(&entry);
+    entry.completed = false;
+    entry.priority = PRIORITY_LOW;
+    entry.tags = 0;
+    entry.date = NULL;
+
+    if(p[0] == 'x' && p[1] == ' ') {
+      entry.completed = true;
+      p += 2;
+    }
+    if(p[0] == '(' && isupper((unsigned char)p[1]) && p[2] == ')' && p[3] == ' ') {
+      entry.priority = map_priority((char[]){p[1], '\0'});
+      p += 4;
+    }
+    // Completion & creation date, the creation date is the last one
+    char date[32] = {0};
+    struct tm tm;
+    while(isdigit((unsigned char)*p)) {
+      memset(&tm, 0, sizeof(tm));
+      char* rest = strptime(p, "%Y-%m-%d", &tm);
+      if(!rest || *rest != ' ') break;
+      strftime(date, sizeof(date), "%d.%m.%Y, 00:00", &tm);
+      p = rest + 1;
+    }
+
+    // Words are compacted in place, tags & key:value pairs are taken out
+    entry.desc = p;
+    char* out = p;
+    while(*p) {
+      while(*p == ' ') p++;
+      if(!*p) break;
+      char* word = p;
+      while(*p && *p != ' ') p++;
+      if(*p) *p++ = '\0';
+
+      if((word[0] == '+' || word[0] == '@') && word[1]) {
+        apply_import_field(ctx, &entry, FIELD_TAGS, word + 1);
+      } else if(strncmp(word, "due:", 4) == 0) {
+        entry.due = import_due(ctx, word + 4);
+      } else if(strncmp(word, "pri:", 4) == 0) {
+        entry.priority = map_priority(word + 4);
+      } else {
+        if(out != entry.desc) *out++ = ' ';
+        size_t len = strlen(word);
+        memmove(out, word, len);
+        out += len;
+      }
+    }
+    *out = '\0';
+    if(date[0]) {
+      entry.date = date;
+    }
+    import_record(ctx, &entry);
+  }
+  mem_free(buf.data);
+}
+
+bool 
+import_todo_list(const char* path, exchange_format format) {
+  double start = bench_now_ms();
+  FILE* input = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+  if(!input) {
+    printf("todo: failed to open '%s' for importing.\n", path);
+    return false;
+  }
+  setvbuf(input, NULL, _IOFBF, EXCHANGE_IO_BUF_SIZE);
+
+  import_ctx ctx = {0};
+  ctx.depth = -1;
+  time_t now = time(NULL);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  strftime(ctx.date, sizeof(ctx.date), "%d.%m.%Y, %H:%M", &tm);
+
+  // Writing the new data file next to the old one & replacing it 
+  FILE* data;
+  list_header header;
+  if(!open_todo_list(s.tododata_file, &data, &ctx.tags, &header)) {
+    close_import_files(input, &ctx);
+    return false;
+  }
+  ctx.seq = header.seq + 1;
+  char tmppath[sizeof(s.tododata_file) + 16];
+  snprintf(tmppath, sizeof(tmppath), "%s.import", s.tododata_file);
+  FILE* out = fopen(tmppath, "wb");
+  if(!out) {
+    printf("todo: failed to write '%s'.\n", tmppath);
+    fclose(data);
+    close_import_files(input, &ctx);
+    return false;
+  }
+  setvbuf(out, NULL, _IOFBF, EXCHANGE_IO_BUF_SIZE);
+  // The header is written again once the number of tasks is known
+  write_list_header(out, 0, &ctx.tags, ctx.seq, header.notes_size);
+
+  // The notes & the tasks already in the list are copied as they are, 
+  // so their order is kept. The header has the same size, so the 
+  // offsets of the notes stay valid.
+  bool ok = !header.notes_size || (fseek(data, header.notes_start, SEEK_SET) == 0 && 
+    copy_bytes(data, out, header.notes_size));
+  todo_entry* entry;
+  while(ok && (entry = deserialize_todo_entry(data, header.version, true)) != NULL) {
+    // Entries of files written before syncing existed are given their ids
+    if(!entry->id) {
+      entry->id = new_entry_id();
+      for(uint32_t i = 0; i < SYNC_FIELD_COUNT; i++) {
+        entry->seqs[i] = ctx.seq;
+      }
+    }
+    serialize_todo_entry(out, entry);
+    ctx.count++;
+    ctx.completed += entry->completed;
+    free_entry(entry);
+  }
+  fclose(data);
+  uint32_t existing = ctx.count;
+
+  // Only the imported records are sorted into place
+  for(uint32_t i = 0; i < PRIORITY_COUNT && ok; i++) {
+    ctx.buckets[i] = tmpfile();
+    if(!ctx.buckets[i]) {
+      printf("todo: failed to create a temporary file for importing.\n");
+      ok = false;
+      break;
+    }
+    setvbuf(ctx.buckets[i], NULL, _IOFBF, EXCHANGE_IO_BUF_SIZE);
+  }
+  if(ok) {
+    switch(format) {
+      case FORMAT_CSV:      import_csv(input, &ctx); break;
+      case FORMAT_JSONL:    import_jsonl(input, &ctx); break;
+      case FORMAT_TODOTXT:  import_todotxt(input, &ctx); break;
+    }
+  }
+  for(int32_t p = PRIORITY_COUNT - 1; p >= 0 && ok; p--) {
+    long size = ftell(ctx.buckets[p]);
+    rewind(ctx.buckets[p]);
+    ok = copy_bytes(ctx.buckets[p], out, size);
+  }
+  close_import_files(input, &ctx);
+  if(ok) {
+    rewind(out);
+    write_list_header(out, ctx.count, &ctx.tags, ctx.seq, header.notes_size);
+  }
+  if(fclose(out) != 0 || !ok || rename(tmppath, s.tododata_file) != 0) {
+    printf("todo: failed to write '%s'.\n", s.tododata_file);
+    remove(tmppath);
+    return false;
+  }
+
+  todo_list* list = &s.lists[s.crnt_list];
+  list->count = ctx.count;
+  list->completed = ctx.completed;
+  save_manifest();
+  clear_op_logs();
+
+  double ms = bench_now_ms() - start;
+  printf("todo: imported %u tasks into '%s' (%u before) in %.1f ms (%.0f tasks/s).\n", 
+         ctx.imported, list->name, existing, ms, ms > 0.0 ? ctx.imported / (ms / 1000.0) : 0.0);
+  if(ctx.skipped) {
+    printf("todo: skipped %u records without a description.\n", ctx.skipped);
+  }
+  if(ctx.dropped_tags) {
+    printf("todo: dropped %u tags, a list cannot have more than %i tags.\n", ctx.dropped_tags, MAX_TAGS);
+  }
+  return true;
+}
+
+void 
+close_import_files(FILE* input, import_ctx* ctx) {
+  if(input != stdin) {
+    fclose(input);
+  }
+  for(uint32_t i = 0; i < PRIORITY_COUNT; i++) {
+    if(ctx->buckets[i]) {
+      fclose(ctx->buckets[i]);
+      ctx->buckets[i] = NULL;
+    }
+  }
+}
+
+void 
+write_csv_field(FILE* file, const char* str, size_t len) {
+  // Quoting fields that contain separators, quotes or line breaks
+  bool quote = false;
+  for(size_t i = 0; i < len; i++) {
+    if(str[i] == ',' || str[i] == '"' || str[i] == '\n' || str[i] == '\r') {
+      quote = true;
+      break;
+    }
+  }
+  if(!quote) {
+    fwrite(str, 1, len, file);
+    return;
+  }
+  fputc('"', file);
+  for(size_t i = 0; i < len; i++) {
+    if(str[i] == '"') fputc('"', file);
+    fputc(str[i], file);
+  }
+  fputc('"', file);
+}
+
+void 
+write_json_string(FILE* file, const char* str, size_t len) {
+  fputc('"', file);
+  for(size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)str[i];
+    switch(c) {
+      case '"':  fputs("\\\"", file); break;
+      case '\\': fputs("\\\\", file); break;
+      case '\n': fputs("\\n", file); break;
+      case '\r': fputs("\\r", file); break;
+      case '\t': fputs("\\t", file); break;
+      default:
+        if(c < 0x20) fprintf(file, "\\u%04x", c);
+        else fputc(c, file);
+        break;
+    }
+  }
+  fputc('"', file);
+}
+
+void 
+export_entry(FILE* file, exchange_format format, todo_entry* entry, tag_table* tags) {
+  static const char* priorities[] = { "low", "medium", "high" };
+  // Dates created with DATE_CMD end with a line break
+  size_t datelen = strlen(entry->date);
+  while(datelen && isspace((unsigned char)entry->date[datelen - 1])) datelen--;
+  char tagsbuf[INPUT_BUF_SIZE] = {0};
+  size_t tagslen = 0;
+  for(uint64_t m = entry->tags; m; m &= m - 1) {
+    tagslen += snprintf(tagsbuf + tagslen, sizeof(tagsbuf) - tagslen, "%s%s", 
+                        tagslen ? "," : "", tags->names[__builtin_ctzll(m)]);
+    if(tagslen >= sizeof(tagsbuf)) break;
+  }
+  char duebuf[32] = {0};
+  if(entry->due) {
+    format_due(entry->due, duebuf, sizeof(duebuf));
+  }
+
+  switch(format) {
+    case FORMAT_CSV: {
+      write_csv_field(file, entry->desc, strlen(entry->desc));
+      fprintf(file, ",%s,%s,", entry->completed ? "true" : "false", priorities[entry->priority]);
+      write_csv_field(file, tagsbuf, strlen(tagsbuf));
+      fputc(',', file);
+      write_csv_field(file, duebuf, strlen(duebuf));
+      fputc(',', file);
+      write_csv_field(file, entry->date, datelen);
+      fprintf(file, ",%u\n", entry->depth);
+      break;
+    }
+    case FORMAT_JSONL: {
+      fputs("{\"description\":", file);
+      write_json_string(file, entry->desc, strlen(entry->desc));
+      fprintf(file, ",\"done\":%s,\"priority\":\"%s\",\"tags\":[", 
+              entry->completed ? "true" : "false", priorities[entry->priority]);
+      uint32_t ntags = 0;
+      for(uint64_t m = entry->tags; m; m &= m - 1) {
+        const char* name = tags->names[__builtin_ctzll(m)];
+        if(ntags++) fputc(',', file);
+        write_json_string(file, name, strlen(name));
+      }
+      fputs("],\"due\":", file);
+      if(entry->due) {
+        write_json_string(file, duebuf, strlen(duebuf));
+      } else {
+        fputs("null", file);
+      }
+      fputs(",\"created\":", file);
+      write_json_string(file, entry->date, datelen);
+      fprintf(file, ",\"depth\":%u}\n", entry->depth);
+      break;
+    }
+    case FORMAT_TODOTXT: {
+      // todo.txt has no levels, completed tasks keep their priority as pri:X
+      static const char letters[] = { 'C', 'B', 'A' };
+      if(entry->completed) {
+        fputs("x ", file);
+      } else {
+        fprintf(file, "(%c) ", letters[entry->priority]);
+      }
+      struct tm tm;
+      memset(&tm, 0, sizeof(tm));
+      if(strptime(entry->date, "%d.%m.%Y", &tm)) {
+        char created[16];
+        strftime(created, sizeof(created), "%Y-%m-%d", &tm);
+        fprintf(file, "%s ", created);
+      }
+      for(const char* c = entry->desc; *c; c++) {
+        fputc(*c == '\n' || *c == '\r' ? ' ' : *c, file);
+      }
+      for(uint64_t m = entry->tags; m; m &= m - 1) {
+        fprintf(file, " +%s", tags->names[__builtin_ctzll(m)]);
+      }
+      if(entry->due) {
+        time_t t = (time_t)entry->due;
+        localtime_r(&t, &tm);
+        char due[16];
+        strftime(due, sizeof(due), "%Y-%m-%d", &tm);
+        fprintf(file, " due:%s", due);
+      }
+      if(entry->completed) {
+        fprintf(file, " pri:%c", letters[entry->priority]);
+      }
+      fputc('\n', file);
+      break;
+    }
+  }
+}
+
+bool 
+export_todo_list(const char* path, exchange_format format) {
+  FILE* data;
+  list_header header;
+  tag_table tags;
+  if(!open_todo_list(s.tododata_file, &data, &tags, &header)) {
+    return false;
+  }
+  FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+  if(!out) {
+    printf("todo: failed to open '%s' for exporting.\n", path);
+    fclose(data);
+    return false;
+  }
+  setvbuf(out, NULL, _IOFBF, EXCHANGE_IO_BUF_SIZE);
+
+  if(format == FORMAT_CSV) {
+    fputs("description,done,priority,tags,due,created,depth\n", out);
+  }
+  // Only one entry is in memory at a time 
+  uint32_t exported = 0;
+  todo_entry* entry;
+  while((entry = deserialize_todo_entry(data, header.version, true)) != NULL) {
+    export_entry(out, format, entry, &tags);
+    free_entry(entry);
+    exported++;
+  }
+  fclose(data);
+  if(out != stdout) {
+    fclose(out);
+    printf("todo: exported %u tasks to '%s'.\n", exported, path);
+  } else {
+    fflush(out);
+  }
+  return true;
+}
+
+void 
+data_file_path(const char* suffix, char* path, size_t size) {
+  snprintf(path, size, "%s%s", s.tododata_file, suffix);
+}
+
+void 
+append_tombstones(const tombstone* tombstones, uint32_t count) {
+  // Recorded input sessions work on a scratch list that is never synced
+  if(!count || s.input.mode != INPUT_LIVE) return;
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(TOMBSTONE_FILE_SUFFIX, path, sizeof(path));
+  FILE* file = fopen(path, "ab");
+  if(!file) {
+    printf("todo: failed to open '%s'.\n", path);
+    return;
+  }
+  fwrite(tombstones, sizeof(tombstone), count, file);
+  fclose(file);
+}
+
+void 
+id_map_init(id_map* map, uint32_t count) {
+  // The capacity is a power of two with room for twice the count
+  map->cap = DA_INIT_CAP;
+  while(map->cap < count * 2) {
+    map->cap *= 2;
+  }
+  map->count = 0;
+  map->keys = mem_calloc(MEM_ARRAYS, map->cap, sizeof(uint64_t));
+  map->values = mem_calloc(MEM_ARRAYS, map->cap, sizeof(todo_entry*));
+  map->removed = mem_calloc(MEM_ARRAYS, map->cap, sizeof(uint64_t));
+  if(!map->keys || !map->values || !map->removed) {
+    fprintf(stderr, "Failed to allocate memory\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+int64_t 
+id_map_find(id_map* map, uint64_t id) {
+  // Ids are random, so their low bits are used as the hash
+  uint32_t mask = map->cap - 1;
+  for(uint32_t i = (uint32_t)(id ^ (id >> 32)) & mask; map->keys[i]; i = (i + 1) & mask) {
+    if(map->keys[i] == id) return i;
+  }
+  return -1;
+}
+
+void 
+id_map_put(id_map* map, uint64_t id, todo_entry* entry, uint64_t removed) {
+  if((map->count + 1) * 2 > map->cap) {
+    id_map old = *map;
+    id_map_init(map, old.cap);
+    for(uint32_t i = 0; i < old.cap; i++) {
+      if(old.keys[i]) id_map_put(map, old.keys[i], old.values[i], old.removed[i]);
+    }
+    id_map_free(&old);
+  }
+  uint32_t mask = map->cap - 1;
+  uint32_t i = (uint32_t)(id ^ (id >> 32)) & mask;
+  while(map->keys[i] && map->keys[i] != id) {
+    i = (i + 1) & mask;
+  }
+  if(!map->keys[i]) {
+    map->keys[i] = id;
+    map->count++;
+  }
+  map->values[i] = entry;
+  map->removed[i] = removed;
+}
+
+void 
+id_map_free(id_map* map) {
+  mem_free(map->keys);
+  mem_free(map->values);
+  mem_free(map->removed);
+  map->keys = NULL;
+  map->values = NULL;
+  map->removed = NULL;
+  map->count = map->cap = 0;
+}
+
+void 
+write_delta_entry(FILE* file, todo_entry* entry, uint64_t parent, tag_table* tags, uint64_t since) {
+  static const char* priorities[] = { "low", "medium", "high" };
+  // Entries created after 'since' are written as a whole, 
+  // the others only with the fields that changed.
+  bool created = entry->seqs[SYNC_CREATED] > since;
+  fprintf(file, "{\"id\":\"%016llx\"", (unsigned long long)entry->id);
+  for(uint32_t f = 0; f < SYNC_FIELD_COUNT; f++) {
+    if(!created && entry->seqs[f] <= since) continue;
+    fprintf(file, ",\"%s\":", sync_field_names[f]);
+    switch((sync_field)f) {
+      case SYNC_CREATED:  write_json_string(file, entry->date, strlen(entry->date)); break;
+      case SYNC_DONE:     fputs(entry->completed ? "true" : "false", file); break;
+      case SYNC_DESC:     write_json_string(file, entry->desc, strlen(entry->desc)); break;
+      case SYNC_PRIORITY: fprintf(file, "\"%s\"", priorities[entry->priority]); break;
+      case SYNC_DUE:      fprintf(file, "%lld", (long long)entry->due); break;
+      case SYNC_PARENT:   fprintf(file, "\"%016llx\"", (unsigned long long)parent); break;
+      case SYNC_TAGS: {
+        // Tags are synced by name, the tag tables of the lists differ
+        uint32_t ntags = 0;
+        fputc('[', file);
+        for(uint64_t m = entry->tags; m; m &= m - 1) {
+          const char* name = tags->names[__builtin_ctzll(m)];
+          if(ntags++) fputc(',', file);
+          write_json_string(file, name, strlen(name));
+        }
+        fputc(']', file);
+        break;
+      }
+      default: break;
+    }
+    fprintf(file, ",\"%s_seq\":%llu", sync_field_names[f], (unsigned long long)entry->seqs[f]);
+  }
+  fputs("}\n", file);
+}
+
+bool 
+export_delta(const char* path, uint64_t since) {
+  FILE* data;
+  list_header header;
+  tag_table tags;
+  if(!open_todo_list(s.tododata_file, &data, &tags, &header)) {
+    return false;
+  }
+  // The entries of files written before syncing existed have no ids 
+  // yet, the list is upgraded first.
+  if(header.version < 4) {
+    fclose(data);
+    entries_da_init(&s.todo_entries);
+    deserialize_todo_list(s.tododata_file, &s.todo_entries, &s.tags, &s.seq);
+    load_stats();
+    if(!save_todo_list() || !open_todo_list(s.tododata_file, &data, &tags, &header)) {
+      return false;
+    }
+  }
+  FILE* out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+  if(!out) {
+    printf("todo: failed to open '%s' for exporting.\n", path);
+    fclose(data);
+    return false;
+  }
+  setvbuf(out, NULL, _IOFBF, EXCHANGE_IO_BUF_SIZE);
+  fprintf(out, "{\"todo_delta\":%i,\"since\":%llu,\"seq\":%llu}\n", DELTA_FORMAT_VERSION, 
+          (unsigned long long)since, (unsigned long long)header.seq);
+
+  // The data file is streamed, only the ids of the 
+  // ancestors of the current entry are kept.
+  uint64_t* parents = NULL;
+  uint32_t parents_cap = 0;
+  uint32_t changed = 0, removed = 0;
+  todo_entry* entry;
+  while((entry = deserialize_todo_entry(data, header.version, true)) != NULL) {
+    if(entry->depth >= parents_cap) {
+      parents_cap = parents_cap ? parents_cap * 2 : DA_INIT_CAP;
+      while(entry->depth >= parents_cap) parents_cap *= 2;
+      uint64_t* temp = (uint64_t*)mem_realloc(MEM_ARRAYS, parents, parents_cap * sizeof(uint64_t));
+      if (!temp) {
+        fprintf(stderr, "Failed to reallocate memory\n");
+        exit(EXIT_FAILURE);
+      }
+      parents = temp;
+    }
+    parents[entry->depth] = entry->id;
+    uint64_t seq = 0;
+    for(uint32_t f = 0; f < SYNC_FIELD_COUNT; f++) {
+      if(entry->seqs[f] > seq) seq = entry->seqs[f];
+    }
+    if(seq > since) {
+      write_delta_entry(out, entry, entry->depth ? parents[entry->depth - 1] : 0, &tags, since);
+      changed++;
+    }
+    free_entry(entry);
+  }
+  fclose(data);
+  mem_free(parents);
+
+  char tombstones_path[sizeof(s.tododata_file) + 16];
+  data_file_path(TOMBSTONE_FILE_SUFFIX, tombstones_path, sizeof(tombstones_path));
+  FILE* tombstones = fopen(tombstones_path, "rb");
+  if(tombstones) {
+    tombstone t;
+    while(fread(&t, sizeof(tombstone), 1, tombstones) == 1) {
+      if(t.seq <= since) continue;
+      fprintf(out, "{\"id\":\"%016llx\",\"deleted\":%llu}\n", (unsigned long long)t.id, (unsigned long long)t.seq);
+      removed++;
+    }
+    fclose(tombstones);
+  }
+
+  if(out != stdout) {
+    fclose(out);
+    printf("todo: exported %u changed & %u removed tasks (sequence numbers %llu to %llu) to '%s'.\n", 
+           changed, removed, (unsigned long long)since, (unsigned long long)header.seq, path);
+  } else {
+    fflush(out);
+  }
+  return true;
+}
+
+bool 
+parse_delta_record(char* line, delta_record* rec) {
+  memset(rec, 0, sizeof(*rec));
+  char* p = line;
+  while(isspace((unsigned char)*p)) p++;
+  if(*p != '{') return false;
+  p++;
+
+  char scratch[64];
+  for(;;) {
+    while(isspace((unsigned char)*p) || *p == ',') p++;
+    if(*p != '"') break;
+    p++;
+    char* key = json_parse_string(&p);
+    while(isspace((unsigned char)*p)) p++;
+    if(*p != ':') break;
+    p++;
+    char* value = json_parse_value(&p, scratch, sizeof(scratch));
+
+    if(strcmp(key, "id") == 0) {
+      rec->id = strtoull(value, NULL, 16);
+      continue;
+    }
+    if(strcmp(key, "deleted") == 0) {
+      rec->deleted = strtoull(value, NULL, 10);
+      continue;
+    }
+    // Every field is followed by the sequence number of its last change
+    size_t keylen = strlen(key);
+    bool isseq = keylen > 4 && strcmp(key + keylen - 4, "_seq") == 0;
+    if(isseq) key[keylen - 4] = '\0';
+    int32_t field = -1;
+    for(uint32_t f = 0; f < SYNC_FIELD_COUNT; f++) {
+      if(strcmp(key, sync_field_names[f]) == 0) field = f;
+    }
+    if(field == -1) continue;
+    if(isseq) {
+      rec->seqs[field] = strtoull(value, NULL, 10);
+      continue;
+    }
+    switch((sync_field)field) {
+      case SYNC_CREATED:  rec->date = value; break;
+      case SYNC_DONE:     rec->completed = map_done(value); break;
+      case SYNC_DESC:     rec->desc = value; break;
+      case SYNC_PRIORITY: rec->priority = map_priority(value); break;
+      case SYNC_TAGS:     rec->tags = value; break;
+      case SYNC_DUE:      rec->due = strtoll(value, NULL, 10); break;
+      case SYNC_PARENT:   rec->parent = strtoull(value, NULL, 16); break;
+      default: break;
+    }
+  }
+  return rec->id != 0;
+}
+
+bool 
+delta_field_wins(const delta_record* rec, const todo_entry* entry, sync_field field) {
+  // The last change wins. Changes made independently with the same 
+  // sequence number are ordered by their values, so both lists agree.
+  if(rec->seqs[field] != entry->seqs[field]) {
+    return rec->seqs[field] > entry->seqs[field];
+  }
+  switch(field) {
+    case SYNC_DONE:     return rec->completed > entry->completed;
+    case SYNC_DESC:     return strcmp(rec->desc ? rec->desc : "", entry->desc) > 0;
+    case SYNC_PRIORITY: return rec->priority > entry->priority;
+    case SYNC_DUE:      return rec->due > entry->due;
+    case SYNC_PARENT:   return rec->parent > (entry->parent ? entry->parent->id : 0);
+    case SYNC_TAGS: {
+      char tagsbuf[INPUT_BUF_SIZE] = {0};
+      size_t tagslen = 0;
+      for(uint64_t m = entry->tags; m; m &= m - 1) {
+        tagslen += snprintf(tagsbuf + tagslen, sizeof(tagsbuf) - tagslen, "%s%s", 
+                            tagslen ? "," : "", s.tags.names[__builtin_ctzll(m)]);
+        if(tagslen >= sizeof(tagsbuf)) break;
+      }
+      return strcmp(rec->tags ? rec->tags : "", tagsbuf) > 0;
+    }
+    default: return false;
+  }
+}
+
+bool 
+apply_delta_field(const delta_record* rec, todo_entry* entry, sync_field field, todo_entry* parent) {
+  switch(field) {
+    case SYNC_DONE: {
+      bool completed = entry->completed;
+      if(rec->completed != completed) {
+        update_progress(entry, 0, rec->completed ? 1 : -1);
+      }
+      entry->completed = rec->completed;
+      stats_change(entry, completed, entry->priority);
+      update_deadline(entry);
+      break;
+    }
+    case SYNC_DESC:
+      if(!rec->desc) return false;
+      mem_free(entry->desc);
+      entry->desc = mem_strdup(MEM_DESCRIPTIONS, rec->desc);
+      break;
+    case SYNC_PRIORITY: {
+      entry_priority priority = entry->priority;
+      entry->priority = rec->priority; 
+      stats_change(entry, entry->completed, priority);
+      break;
+    }
+    case SYNC_TAGS:
+      entry->tags = rec->tags ? parse_tags(&s.tags, rec->tags, true, NULL) : 0;
+      break;
+    case SYNC_DUE:
+      entry->due = rec->due;
+      update_deadline(entry);
+      break;
+    case SYNC_PARENT:
+      // Moves under a parent this list doesn't have are dropped
+      if(rec->parent && !parent) return false;
+      if(parent != entry->parent && !move_entry(entry, parent)) return false;
+      break;
+    default: 
+      return false;
+  }
+  return true;
+}
+
+bool 
+apply_delta(const char* path) {
+  FILE* input = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+  if(!input) {
+    printf("todo: failed to open '%s' for applying.\n", path);
+    return false;
+  }
+  exchange_buf buf = {0};
+  if(!read_line(input, &buf) || !strstr(buf.data, "\"todo_delta\"")) {
+    printf("todo: '%s' is not a delta.\n", path);
+    if(input != stdin) fclose(input);
+    mem_free(buf.data);
+    return false;
+  }
+
+  // Indexing the removed entries & the entries by their ids. Removed 
+  // entries can be restored (by undoing the removal), so the entries 
+  // come last.
+  id_map ids;
+  id_map_init(&ids, s.todo_entries.count);
+  char tombstones_path[sizeof(s.tododata_file) + 16];
+  data_file_path(TOMBSTONE_FILE_SUFFIX, tombstones_path, sizeof(tombstones_path));
+  FILE* tombstones = fopen(tombstones_path, "rb");
+  if(tombstones) {
+    tombstone t;
+    while(fread(&t, sizeof(tombstone), 1, tombstones) == 1) {
+      id_map_put(&ids, t.id, NULL, t.seq);
+    }
+    fclose(tombstones);
+  }
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    id_map_put(&ids, s.todo_entries.entries[i]->id, s.todo_entries.entries[i], 0);
+  }
+
+  uint32_t added = 0, updated = 0, removed = 0, ignored = 0;
+  delta_record rec;
+  while(read_line(input, &buf)) {
+    if(!parse_delta_record(buf.data, &rec)) continue;
+
+    // Later local changes have to win over the ones applied now
+    for(uint32_t f = 0; f < SYNC_FIELD_COUNT; f++) {
+      if(rec.seqs[f] > s.seq) s.seq = rec.seqs[f];
+    }
+    if(rec.deleted > s.seq) s.seq = rec.deleted;
+
+    int64_t slot = id_map_find(&ids, rec.id);
+    todo_entry* existing = slot != -1 ? ids.values[slot] : NULL;
+    if(rec.deleted) {
+      // Removals older than the (re)creation of the entry are dropped
+      if(existing && rec.deleted >= existing->seqs[SYNC_CREATED]) {
+        // Removing the entry together with its subtasks
+        uint32_t i = find_entry(existing);
+        for(uint32_t j = i; j <= i + existing->nsubtasks; j++) {
+          id_map_put(&ids, s.todo_entries.entries[j]->id, NULL, rec.deleted);
+        }
+        remove_entry(i);
+        removed++;
+      } else if(slot == -1) {
+        // Remembering removals of entries this list never had, 
+        // so they aren't brought back by a later delta.
+        tombstone t = {.id = rec.id, .seq = rec.deleted};
+        append_tombstones(&t, 1);
+        id_map_put(&ids, rec.id, NULL, rec.deleted);
+      }
+      continue;
+    }
+    // Changes of entries that were removed here are dropped, 
+    // unless the entry was restored after the removal.
+    if(slot != -1 && !existing && rec.seqs[SYNC_CREATED] <= ids.removed[slot]) {
+      ignored++;
+      continue;
+    }
+
+    todo_entry* parent = NULL;
+    if(rec.parent) {
+      int64_t parent_slot = id_map_find(&ids, rec.parent);
+      parent = parent_slot != -1 ? ids.values[parent_slot] : NULL;
+    }
+    if(!existing) {
+      // Entries this list doesn't know yet need to be sent whole
+      if(!rec.seqs[SYNC_CREATED] || !rec.desc) {
+        ignored++;
+        continue;
+      }
+      todo_entry* entry = mem_alloc(MEM_ENTRIES, sizeof(todo_entry));
+      init_entry(entry);
+      entry->id = rec.id;
+      entry->desc = mem_strdup(MEM_DESCRIPTIONS, rec.desc);
+      entry->date = mem_strdup(MEM_DATES, rec.date ? rec.date : "");
+      entry->completed = rec.completed;
+      entry->priority = rec.priority;
+      entry->tags = rec.tags ? parse_tags(&s.tags, rec.tags, true, NULL) : 0;
+      entry->due = rec.due;
+      memcpy(entry->seqs, rec.seqs, sizeof(entry->seqs));
+      insert_entry(entry, parent);
+      sort_entry(entry);
+      update_deadline(entry);
+      id_map_put(&ids, entry->id, entry, 0);
+      added++;
+      continue;
+    }
+
+    // Only the fields whose change is newer than ours are applied
+    todo_entry* entry = existing;
+    bool changed = false, moved = false;
+    for(uint32_t f = SYNC_DONE; f < SYNC_FIELD_COUNT; f++) {
+      if(!rec.seqs[f] || !delta_field_wins(&rec, entry, (sync_field)f)) continue;
+      if(!apply_delta_field(&rec, entry, (sync_field)f, parent)) continue;
+      entry->seqs[f] = rec.seqs[f];
+      changed = true;
+      moved |= f == SYNC_PRIORITY || f == SYNC_PARENT;
+    }
+    // Merged entries are placed among their siblings right away 
+    // instead of sorting the whole list afterwards.
+    if(moved) {
+      sort_entry(entry);
+    }
+    updated += changed;
+  }
+  if(input != stdin) {
+    fclose(input);
+  }
+  mem_free(buf.data);
+  id_map_free(&ids);
+
+  if(!save_todo_list()) {
+    return false;
+  }
+  clear_op_logs();
+  printf("todo: applied delta: %u added, %u updated, %u removed, %u ignored (now at sequence number %llu).\n", 
+         added, updated, removed, ignored, (unsigned long long)s.seq);
+  return true;
+}
+
+list_op 
+make_op(op_type type, uint32_t i) {
+  // Captures where the entry at i is, before it is changed
+  todo_entry* entry = s.todo_entries.entries[i];
+  return (list_op){
+    .type = type, 
+    .pos = i,
+    .id = entry->id, 
+    .parent = entry->parent ? entry->parent->id : 0, 
+    .anchor = next_sibling_id(i)
+  };
+}
+
+void 
+record_op(list_op* op) {
+  // Additions & removals keep the subtree, so it can be brought back
+  char* payload = NULL;
+  size_t size = 0;
+  if(op->type == OP_ADD || op->type == OP_REMOVE) {
+    FILE* file = open_memstream(&payload, &size);
+    todo_entry* entry = s.todo_entries.entries[op->pos];
+    for(uint32_t j = op->pos; j <= op->pos + entry->nsubtasks; j++) {
+      serialize_todo_entry(file, s.todo_entries.entries[j]);
+    }
+    fclose(file);
+  }
+  op->payload_size = size;
+  push_op(UNDO_FILE_SUFFIX, op, payload);
+  free(payload);
+
+  // A new change makes the undone changes unreachable
+  clear_op_log(REDO_FILE_SUFFIX);
+}
+
+void 
+push_op(const char* suffix, const list_op* op, const char* payload) {
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(suffix, path, sizeof(path));
+  FILE* file = fopen(path, "ab");
+  if(!file) {
+    printf("todo: failed to open '%s'.\n", path);
+    return;
+  }
+  // Every record ends with its size, so the last one can be 
+  // found from the end of the log.
+  uint32_t size = sizeof(list_op) + op->payload_size + sizeof(uint32_t);
+  fwrite(op, sizeof(list_op), 1, file);
+  if(op->payload_size) {
+    fwrite(payload, 1, op->payload_size, file);
+  }
+  fwrite(&size, sizeof(uint32_t), 1, file);
+  long end = ftell(file);
+  fclose(file);
+  if(end > UNDO_LOG_MAX_SIZE) {
+    trim_op_log(path, end);
+  }
+}
+
+bool 
+pop_op(const char* suffix, list_op* op, char** payload) {
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(suffix, path, sizeof(path));
+  FILE* file = fopen(path, "r+b");
+  if(!file) return false;
+
+  uint32_t size;
+  long end;
+  if(fseek(file, -(long)sizeof(uint32_t), SEEK_END) != 0 || 
+     fread(&size, sizeof(uint32_t), 1, file) != 1 || 
+     (end = ftell(file)) < (long)size || size < sizeof(list_op) + sizeof(uint32_t) ||
+     fseek(file, end - size, SEEK_SET) != 0 ||
+     fread(op, sizeof(list_op), 1, file) != 1 || 
+     op->payload_size != size - sizeof(list_op) - sizeof(uint32_t)) {
+    fclose(file);
+    return false;
+  }
+  *payload = mem_alloc(MEM_OTHER, op->payload_size + 1);
+  if(fread(*payload, 1, op->payload_size, file) != op->payload_size) {
+    mem_free(*payload);
+    fclose(file);
+    return false;
+  }
+  // Popping is cutting the record off the end of the log
+  fflush(file);
+  if(ftruncate(fileno(file), end - size) != 0) {
+    printf("todo: failed to truncate '%s'.\n", path);
+  }
+  fclose(file);
+  return true;
+}
+
+void 
+trim_op_log(const char* path, long size) {
+  // Dropping the oldest records until the log is half its maximum size
+  FILE* file = fopen(path, "rb");
+  if(!file) return;
+  long offset = 0;
+  list_op op;
+  while(size - offset > UNDO_LOG_MAX_SIZE / 2 && fread(&op, sizeof(list_op), 1, file) == 1) {
+    offset += sizeof(list_op) + op.payload_size + sizeof(uint32_t);
+    fseek(file, offset, SEEK_SET);
+  }
+  char tmppath[sizeof(s.tododata_file) + 32];
+  snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+  FILE* out = fopen(tmppath, "wb");
+  if(!out) {
+    fclose(file);
+    return;
+  }
+  char chunk[EXCHANGE_IO_BUF_SIZE];
+  size_t n;
+  while((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    fwrite(chunk, 1, n, out);
+  }
+  fclose(file);
+  if(fclose(out) != 0 || rename(tmppath, path) != 0) {
+    remove(tmppath);
+  }
+}
+
+void 
+clear_op_logs() {
+  // Positions in the logs are only valid for the list they were recorded on
+  clear_op_log(UNDO_FILE_SUFFIX);
+  clear_op_log(REDO_FILE_SUFFIX);
+}
+
+void 
+clear_op_log(const char* suffix) {
+  // A log that doesn't exist yet is empty already
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(suffix, path, sizeof(path));
+  if(truncate(path, 0) != 0 && errno != ENOENT) {
+    printf("todo: failed to clear '%s'.\n", path);
+  }
+}
+
+int32_t 
+find_op_entry(uint32_t pos, uint64_t id) {
+  if(pos < s.todo_entries.count && s.todo_entries.entries[pos]->id == id) {
+    return pos;
+  }
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    if(s.todo_entries.entries[i]->id == id) return i;
+  }
+  return -1;
+}
+
+void 
+restore_subtree(const list_op* op, char* payload) {
+  entries_da block;
+  entries_da_init(&block);
+  FILE* file = fmemopen(payload, op->payload_size, "rb");
+  todo_entry* entry;
+  while((entry = deserialize_todo_entry(file, DATA_FORMAT_VERSION, true)) != NULL) {
+    entry->tags &= tag_mask(&s.tags);
+    entries_da_push(&block, entry);
+  }
+  fclose(file);
+  if(!block.count) {
+    entries_da_free(&block, false);
+    return;
+  }
+  init_tree(&block);
+
+  // Bringing entries back is a new creation of them (for syncing)
+  uint64_t seq = ++s.seq;
+  for(uint32_t i = 0; i < block.count; i++) {
+    for(uint32_t f = 0; f < SYNC_FIELD_COUNT; f++) {
+      block.entries[i]->seqs[f] = seq;
+    }
+  }
+  // The next sibling is where the subtree was, the parent comes before it
+  int32_t parent = op->parent ? find_op_entry(UINT32_MAX, op->parent) : -1;
+  int32_t anchor = op->anchor ? find_op_entry(op->pos, op->anchor) : -1;
+  place_subtree(block.entries, block.count, 
+                parent != -1 ? s.todo_entries.entries[parent] : NULL, 
+                anchor != -1 ? s.todo_entries.entries[anchor] : NULL);
+  for(uint32_t i = 0; i < block.count; i++) {
+    update_deadline(block.entries[i]);
+    stats_add_entry(block.entries[i], 1);
+  }
+  entries_da_free(&block, false);
+}
+
+bool 
+apply_op(const list_op* op, char* payload, bool undo) {
+  if((op->type == OP_ADD && !undo) || (op->type == OP_REMOVE && undo)) {
+    restore_subtree(op, payload);
+    return true;
+  }
+  int32_t i = find_op_entry(op->pos, op->id);
+  if(i == -1) return false;
+  todo_entry* entry = s.todo_entries.entries[i];
+  uint64_t value = undo ? op->before : op->after;
+
+  switch((op_type)op->type) {
+    case OP_ADD:
+    case OP_REMOVE:
+      remove_entry(i);
+      break;
+    case OP_TOGGLE: {
+      bool completed = entry->completed;
+      if((bool)value != completed) {
+        update_progress(entry, 0, value ? 1 : -1);
+      }
+      entry->completed = (bool)value;
+      stats_change(entry, completed, entry->priority);
+      touch_entry(entry, SYNC_DONE);
+      update_deadline(entry);
+      break;
+    }
+    case OP_TAGS:
+      // Tags that were dropped since can't be restored
+      entry->tags = value & tag_mask(&s.tags);
+      touch_entry(entry, SYNC_TAGS);
+      break;
+    case OP_DUE:
+      entry->due = (int64_t)value;
+      touch_entry(entry, SYNC_DUE);
+      update_deadline(entry);
+      break;
+    case OP_PRIORITY:
+    case OP_REORDER: {
+      if(op->type == OP_PRIORITY) {
+        entry_priority priority = entry->priority;
+        entry->priority = (entry_priority)value;
+        stats_change(entry, entry->completed, priority);
+        touch_entry(entry, SYNC_PRIORITY);
+      }
+      if(!undo) {
+        // Doing it again is the same as the first time
+        if(op->type == OP_PRIORITY) {
+          sort_entries_by_priority(&s.todo_entries);
+        } else {
+          raise_entry(i);
+        }
+        break;
+      }
+      // Moving the entry back in front of the sibling it was in front of
+      int32_t anchor = op->anchor ? find_op_entry(i + entry->nsubtasks + 1, op->anchor) : -1;
+      if(op->anchor && (anchor == -1 || s.todo_entries.entries[anchor]->parent != entry->parent)) {
+        break;
+      }
+      todo_entry* sibling = anchor != -1 ? s.todo_entries.entries[anchor] : NULL;
+      todo_entry** block;
+      uint32_t n = take_subtree(i, &block);
+      place_subtree(block, n, entry->parent, sibling);
+      mem_free(block);
+      break;
+    }
+  }
+  return true;
+}
+
+bool 
+undo(bool redo) {
+  // Undoing moves the last change from the undo to the redo log, 
+  // redoing moves it back.
+  list_op op;
+  char* payload;
+  if(!pop_op(redo ? REDO_FILE_SUFFIX : UNDO_FILE_SUFFIX, &op, &payload)) {
+    return false;
+  }
+  bool applied = apply_op(&op, payload, !redo);
+  if(applied) {
+    push_op(redo ? UNDO_FILE_SUFFIX : REDO_FILE_SUFFIX, &op, payload);
+    applied = save_todo_list();
+  }
+  mem_free(payload);
+  return applied;
+}
+
+void 
+stats_add(const char* date, bool completed, entry_priority priority, int32_t sign) {
+  list_stats* st = &s.stats;
+  st->count += sign;
+  st->completed += completed ? sign : 0;
+  if(priority < PRIORITY_COUNT) {
+    st->priorities[priority] += sign;
+  }
+  if(completed) return;
+  int64_t created = parse_entry_date(date);
+  if(created != -1) {
+    st->open_dated += sign;
+    st->open_created += sign * created;
+  }
+}
+
+void 
+stats_add_entry(const todo_entry* entry, int32_t sign) {
+  stats_add(entry->date, entry->completed, entry->priority, sign);
+}
+
+void 
+stats_change(const todo_entry* entry, bool completed, entry_priority priority) {
+  // Moves the contribution of an entry from its old 
+  // completion & priority to the current ones.
+  stats_add(entry->date, completed, priority, -1);
+  stats_add_entry(entry, 1);
+  if(entry->completed != completed) {
+    stats_count_completion(entry->completed ? 1 : -1);
+  }
+}
+
+void 
+stats_count_completion(int32_t n) {
+  // Tasks marked as not done again are taken back from today's count
+  int32_t today = (int32_t)(now_minutes() / (24 * 60));
+  day_count* slot = &s.stats.completions[today % STATS_HISTORY_DAYS];
+  if(slot->day != today) {
+    slot->day = today;
+    slot->count = 0;
+  }
+  if(n < 0 && slot->count < (uint32_t)-n) {
+    slot->count = 0;
+  } else {
+    slot->count += n;
+  }
+}
+
+void 
+stats_history(uint32_t* counts, uint32_t ndays) {
+  // Completions of the last ndays days, today last
+  int32_t today = (int32_t)(now_minutes() / (24 * 60));
+  for(uint32_t i = 0; i < ndays; i++) {
+    int32_t day = today - (int32_t)(ndays - 1 - i);
+    const day_count* slot = &s.stats.completions[day % STATS_HISTORY_DAYS];
+    counts[i] = slot->day == day ? slot->count : 0;
+  }
+}
+
+void 
+stats_rebuild() {
+  // Recomputing the aggregates from the loaded entries, the history is kept
+  list_stats* st = &s.stats;
+  st->count = 0;
+  st->completed = 0;
+  memset(st->priorities, 0, sizeof(st->priorities));
+  st->open_dated = 0;
+  st->open_created = 0;
+  for(uint32_t i = 0; i < s.todo_entries.count; i++) {
+    stats_add_entry(s.todo_entries.entries[i], 1);
+  }
+}
+
+bool 
+read_stats(const char* path, list_stats* stats, uint64_t* seq) {
+  FILE* file = fopen(path, "rb");
+  if(!file) return false;
+  uint32_t version;
+  bool ok = fread(&version, sizeof(uint32_t), 1, file) == 1 && version == STATS_FORMAT_VERSION && 
+    fread(seq, sizeof(uint64_t), 1, file) == 1 && 
+    fread(stats, sizeof(list_stats), 1, file) == 1;
+  fclose(file);
+  return ok;
+}
+
+void 
+load_stats() {
+  // The stats file holds the aggregates as of the sequence number it was 
+  // written at. If the list was changed without it (e.g. by an import), 
+  // they are recomputed, the history of completions is taken either way.
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(STATS_FILE_SUFFIX, path, sizeof(path));
+  uint64_t seq;
+  if(!read_stats(path, &s.stats, &seq)) {
+    memset(&s.stats, 0, sizeof(s.stats));
+  } else if(seq == s.seq) {
+    return;
+  }
+  stats_rebuild();
+}
+
+void 
+save_stats() {
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(STATS_FILE_SUFFIX, path, sizeof(path));
+  FILE* file = fopen(path, "wb");
+  if(!file) {
+    printf("todo: failed to open '%s'.\n", path);
+    return;
+  }
+  uint32_t version = STATS_FORMAT_VERSION;
+  fwrite(&version, sizeof(uint32_t), 1, file);
+  fwrite(&s.seq, sizeof(uint64_t), 1, file);
+  fwrite(&s.stats, sizeof(list_stats), 1, file);
+  fclose(file);
+}
+
+void 
+format_stats(char* buf, size_t size) {
+  const list_stats* st = &s.stats;
+  double ratio = st->count ? 100.0 * st->completed / st->count : 0.0;
+  double age = st->open_dated ? 
+    ((double)now_minutes() - (double)st->open_created / st->open_dated) / (24.0 * 60.0) : 0.0;
+  snprintf(buf, size, "%u tasks, %.0f%% done | %u high, %u medium, %u low | open tasks are %.1f days old on average", 
+           st->count, ratio, st->priorities[PRIORITY_HIGH], st->priorities[PRIORITY_MEDIUM], 
+           st->priorities[PRIORITY_LOW], age);
+}
+
+bool 
+print_stats() {
+  // The stats file is used as long as it is up to date, otherwise the 
+  // entries are scanned without reading their descriptions.
+  FILE* data;
+  list_header header;
+  tag_table tags;
+  if(!open_todo_list(s.tododata_file, &data, &tags, &header)) {
+    return false;
+  }
+  char path[sizeof(s.tododata_file) + 16];
+  data_file_path(STATS_FILE_SUFFIX, path, sizeof(path));
+  uint64_t seq;
+  bool fresh = read_stats(path, &s.stats, &seq);
+  if(!fresh) {
+    memset(&s.stats, 0, sizeof(s.stats));
+  }
+  fresh = fresh && header.version >= 4 && seq == header.seq;
+  if(!fresh) {
+    stats_rebuild();
+    todo_entry* entry;
+    while((entry = deserialize_todo_entry(data, header.version, false)) != NULL) {
+      stats_add_entry(entry, 1);
+      free_entry(entry);
+    }
+    // Files without sequence numbers are given them when loaded
+    if(header.version >= 4) {
+      s.seq = header.seq;
+      save_stats();
+    }
+  }
+  fclose(data);
+
+  char summary[256];
+  format_stats(summary, sizeof(summary));
+  printf("======== Statistics ========\n");
+  printf("%s\n", summary);
+  printf("Completed in the last %u days:\n", STATS_SHOWN_DAYS);
+  uint32_t counts[STATS_SHOWN_DAYS];
+  stats_history(counts, STATS_SHOWN_DAYS);
+  int32_t today = (int32_t)(now_minutes() / (24 * 60));
+  for(uint32_t i = 0; i < STATS_SHOWN_DAYS; i++) {
+    // Day numbers are local days since the epoch
+    time_t t = (time_t)(today - (int32_t)(STATS_SHOWN_DAYS - 1 - i)) * 24 * 60 * 60;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char day[16];
+    strftime(day, sizeof(day), "%d.%m.%Y", &tm);
+    printf("%s %3u ", day, counts[i]);
+    for(uint32_t j = 0; j < counts[i] && j < 50; j++) {
+      putchar('#');
+    }
+    putchar('\n');
+  }
+  printf("============================\n");
+  return true;
+}
+
+int64_t 
+days_from_civil(int64_t y, uint32_t m, uint32_t d) {
+  // Days since 01.01.1970 of a date in the proleptic gregorian calendar
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = (uint32_t)(y - era * 400);
+  uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+int64_t 
+parse_entry_date(const char* date) {
+  // Creation dates are local time in the format of DATE_CMD, they are 
+  // converted to minutes without going through mktime().
+  int32_t d, m, y, hour = 0, min = 0;
+  if(!date || sscanf(date, "%d.%d.%d, %d:%d", &d, &m, &y, &hour, &min) < 3 || 
+     m < 1 || m > 12 || d < 1 || d > 31) {
+    return -1;
+  }
+  return days_from_civil(y, m, d) * 24 * 60 + hour * 60 + min;
+}
+
+int64_t 
+now_minutes() {
+  time_t t = time(NULL);
+  struct tm tm;
+  localtime_r(&t, &tm);
+  return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * 24 * 60 + 
+    tm.tm_hour * 60 + tm.tm_min;
+}
+
+void print_requires_argument(const char* option, uint32_t numargs) {
+  printf("todo: option requires %i argument(s): '%s'\n", numargs, option);
+  printf("Try todo --help for more information\n");
 }
 
 void str_to_lower(char* str) {
@@ -758,43 +5806,514 @@ void str_to_lower(char* str) {
   }
 }
 
+bool 
+is_gui_option(const char* arg) {
+  static const char* options[] = {
+    "--record", "--replay", "--synthetic", "--synthetic-shape", "--frame-budget", "--frame-log", 
+    "--startup-stats"
+  };
+  for(uint32_t i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+    if(strcmp(arg, options[i]) == 0) return true;
+  }
+  return false;
+}
+
+bool 
+parse_gui_options(int argc, char** argv) {
+  const char* replay_file = NULL;
+  int64_t synthetic_count = -1;
+  const char* synthetic_shape = NULL;
+
+  for(int32_t i = 1; i < argc; i++) {
+    const char* option = argv[i];
+    if(!is_gui_option(option)) {
+      printf("todo: invalid option: '%s'.\n", option);
+      printf("Try todo --help for more information.\n");
+      return false;
+    }
+    // Flags without an argument
+    if(strcmp(option, "--startup-stats") == 0) {
+      s.startup.stats = true;
+      continue;
+    }
+    if(i + 1 >= argc) {
+      print_requires_argument(option, 1);
+      return false;
+    }
+    const char* arg = argv[++i];
+
+    if(strcmp(option, "--record") == 0) {
+      s.input.mode = INPUT_RECORD;
+      s.input.log = fopen(arg, "w");
+      if(!s.input.log) {
+        printf("todo: failed to open input log '%s' for writing.\n", arg);
+        return false;
+      }
+    } 
+    else if(strcmp(option, "--replay") == 0) {
+      s.input.mode = INPUT_REPLAY;
+      replay_file = arg;
+    }
+    else if(strcmp(option, "--synthetic") == 0) {
+      synthetic_count = atoi(arg);
+      if(synthetic_count < 0) {
+        printf("todo: invalid synthetic entry count: '%s'.\n", arg);
+        return false;
+      }
+    }
+    else if(strcmp(option, "--synthetic-shape") == 0) {
+      if(strcmp(arg, "flat") != 0 && strcmp(arg, "tree") != 0) {
+        printf("todo: invalid synthetic shape: '%s' (valid shapes: {flat, tree})\n", arg);
+        return false;
+      }
+      synthetic_shape = arg;
+    }
+    else if(strcmp(option, "--frame-budget") == 0) {
+      s.input.frame_budget_ms = atof(arg);
+    }
+    else if(strcmp(option, "--frame-log") == 0) {
+      s.input.frame_log = fopen(arg, "w");
+      if(!s.input.frame_log) {
+        printf("todo: failed to open frame log '%s' for writing.\n", arg);
+        return false;
+      }
+      fprintf(s.input.frame_log, "frame,ms\n");
+    }
+  }
+
+  if(s.input.mode == INPUT_LIVE && (synthetic_count != -1 || synthetic_shape)) {
+    printf("todo: --synthetic and --synthetic-shape require --record or --replay.\n");
+    return false;
+  }
+
+  s.input.synthetic_count = REPLAY_SYNTHETIC_ENTRIES;
+  if(s.input.mode == INPUT_REPLAY && !load_input_log(replay_file)) {
+    return false;
+  }
+  // An explicit count overrides the one stored in the log, so a recording 
+  // can be replayed against a larger data set.
+  if(synthetic_count != -1) {
+    s.input.synthetic_count = (uint32_t)synthetic_count;
+  }
+  if(synthetic_shape) {
+    s.input.synthetic_tree = strcmp(synthetic_shape, "tree") == 0;
+  }
+
+  // The shape is only written for trees, so flat logs keep the header 
+  // they had before subtasks existed.
+  if(s.input.mode == INPUT_RECORD) {
+    fprintf(s.input.log, "todo-input-log %i %u%s\n", INPUT_LOG_VERSION, 
+            s.input.synthetic_count, s.input.synthetic_tree ? " tree" : "");
+  }
+  return true;
+}
+
+void 
+input_events_da_push(input_events_da* da, input_event ev) {
+  if(da->count == da->cap) {
+    da->cap = da->cap ? da->cap * 2 : DA_INIT_CAP;
+    input_event* temp = (input_event*)mem_realloc(MEM_ARRAYS, da->events, da->cap * sizeof(input_event));
+    if (!temp) {
+      fprintf(stderr, "Failed to reallocate memory\n");
+      exit(EXIT_FAILURE);
+    }
+    da->events = temp;
+  }
+  da->events[da->count++] = ev;
+}
+
+void 
+record_input_event(input_event ev) {
+  fprintf(s.input.log, "e %lu %i %i %i %i %i %.17g %.17g\n", 
+          (unsigned long)s.input.frame, ev.type, 
+          ev.args[0], ev.args[1], ev.args[2], ev.args[3], 
+          ev.x, ev.y);
+}
+
+bool 
+load_input_log(const char* filename) {
+  FILE* file = fopen(filename, "r");
+  if(!file) {
+    printf("todo: failed to open input log '%s'.\n", filename);
+    return false;
+  }
+
+  int32_t version;
+  char header[64], shape[8] = "flat";
+  if(!fgets(header, sizeof(header), file) || 
+     sscanf(header, "todo-input-log %i %u %7s", &version, &s.input.synthetic_count, shape) < 2) {
+    printf("todo: '%s' is not a valid input log.\n", filename);
+    fclose(file);
+    return false;
+  }
+  // Logs of other versions were recorded against a different 
+  // synthetic data set, so their frame times are not comparable.
+  if(version != INPUT_LOG_VERSION) {
+    printf("todo: '%s' was recorded with input log version %i, this is version %i. Record it again.\n", 
+           filename, version, INPUT_LOG_VERSION);
+    fclose(file);
+    return false;
+  }
+  s.input.synthetic_tree = strcmp(shape, "tree") == 0;
+
+  char tag[8];
+  while(fscanf(file, "%7s", tag) == 1) {
+    unsigned long frame;
+    if(strcmp(tag, "end") == 0) {
+      if(fscanf(file, "%lu", &frame) == 1) {
+        s.input.end_frame = frame;
+      }
+      break;
+    }
+    input_event ev;
+    int32_t type;
+    if(strcmp(tag, "e") != 0 || 
+       fscanf(file, "%lu %i %i %i %i %i %lf %lf", &frame, &type, 
+              &ev.args[0], &ev.args[1], &ev.args[2], &ev.args[3], &ev.x, &ev.y) != 8) {
+      printf("todo: malformed event in input log '%s'.\n", filename);
+      fclose(file);
+      return false;
+    }
+    ev.frame = frame;
+    ev.type = (input_event_type)type;
+    input_events_da_push(&s.input.events, ev);
+    s.input.end_frame = ev.frame;
+  }
+  fclose(file);
+  return true;
+}
+
+bool 
+replay_input_frame() {
+  input_harness* in = &s.input;
+  while(in->crnt_event < in->events.count && 
+    in->events.events[in->crnt_event].frame <= in->frame) {
+    dispatch_input_event(&in->events.events[in->crnt_event++]);
+  }
+  return in->frame < in->end_frame;
+}
+
+void 
+dispatch_input_event(const input_event* ev) {
+  const int32_t* a = ev->args;
+  switch(ev->type) {
+    case INPUT_EVENT_KEY:
+      s.input.lf_keycb(s.win, a[0], a[1], a[2], a[3]);
+      break;
+    case INPUT_EVENT_CHAR:
+      s.input.lf_charcb(s.win, (uint32_t)a[0]);
+      break;
+    case INPUT_EVENT_MOUSE_BUTTON:
+      s.input.lf_mousebuttoncb(s.win, a[0], a[1], a[2]);
+      break;
+    case INPUT_EVENT_CURSOR_POS:
+      s.input.lf_cursorposcb(s.win, ev->x, ev->y);
+      break;
+    case INPUT_EVENT_SCROLL:
+      s.input.lf_scrollcb(s.win, ev->x, ev->y);
+      break;
+    case INPUT_EVENT_RESIZE:
+      // Without a window, the resize callback does not treat 
+      // the event as live input. 
+      resizecb(NULL, a[0], a[1]);
+      break;
+  }
+}
+
+void 
+push_frame_time(double ms) {
+  input_harness* in = &s.input;
+  if(in->frametimes_count == in->frametimes_cap) {
+    in->frametimes_cap = in->frametimes_cap ? in->frametimes_cap * 2 : DA_INIT_CAP;
+    double* temp = (double*)mem_realloc(MEM_ARRAYS, in->frametimes, in->frametimes_cap * sizeof(double));
+    if (!temp) {
+      fprintf(stderr, "Failed to reallocate memory\n");
+      exit(EXIT_FAILURE);
+    }
+    in->frametimes = temp;
+  }
+  in->frametimes[in->frametimes_count++] = ms;
+  if(in->frame_log) {
+    fprintf(in->frame_log, "%lu,%.4f\n", (unsigned long)in->frame, ms);
+  }
+}
+
+int
+compare_frame_time(const void* a, const void* b) {
+  double da = *(const double*)a, db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+bool 
+report_frame_timings() {
+  input_harness* in = &s.input;
+  if(!in->frametimes_count) {
+    printf("todo: no frames were replayed.\n");
+    return false;
+  }
+  uint64_t n = in->frametimes_count;
+  double total = 0.0;
+  for(uint64_t i = 0; i < n; i++) {
+    total += in->frametimes[i];
+  }
+  // Sorting in place, the per frame values already went to the frame log
+  qsort(in->frametimes, n, sizeof(double), compare_frame_time);
+  double p50 = in->frametimes[(n - 1) * 50 / 100];
+  double p95 = in->frametimes[(n - 1) * 95 / 100];
+  double p99 = in->frametimes[(n - 1) * 99 / 100];
+
+  printf("======== Replay Timings ========\n");
+  printf("frames:   %lu (%u entries)\n", (unsigned long)n, in->synthetic_count);
+  printf("total:    %.2f ms\n", total);
+  printf("avg:      %.3f ms\n", total / n);
+  printf("p50:      %.3f ms\n", p50);
+  printf("p95:      %.3f ms\n", p95);
+  printf("p99:      %.3f ms\n", p99);
+  printf("max:      %.3f ms\n", in->frametimes[n - 1]);
+  printf("memory:   %.1f KB (peak %.1f KB)\n", s.mem.total / 1024.0, s.mem.peak / 1024.0);
+  printf("================================\n");
+
+  if(in->frame_budget_ms > 0.0 && p95 > in->frame_budget_ms) {
+    printf("todo: frame budget exceeded: p95 %.3f ms > %.3f ms\n", p95, in->frame_budget_ms);
+    return false;
+  }
+  return true;
+}
+
+uint32_t
+xorshift32(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+void 
+gen_synthetic_entries(entries_da* da, tag_table* tags, uint32_t count, bool tree) {
+  static const char* words[] = {
+    "deploy", "review", "fix", "write", "update", "refactor", "test", "ship",
+    "server", "docs", "parser", "release", "build", "cache", "layout", "config"
+  };
+  const uint32_t nwords = sizeof(words) / sizeof(words[0]);
+  static const char* tagnames[] = {
+    "infra", "oncall", "frontend", "backend", "docs", "release"
+  };
+  const uint32_t ntags = sizeof(tagnames) / sizeof(tagnames[0]);
+  memset(tags, 0, sizeof(*tags));
+  for(uint32_t i = 0; i < ntags; i++) {
+    add_tag(tags, tagnames[i]);
+  }
+
+  // Fixed seed so every run sees the exact same data 
+  uint32_t seed = 0x9E3779B9;
+  for(uint32_t i = 0; i < count; i++) {
+    char desc[INPUT_BUF_SIZE];
+    snprintf(desc, sizeof(desc), "%s %s %s #%u", 
+             words[xorshift32(&seed) % nwords], 
+             words[xorshift32(&seed) % nwords], 
+             words[xorshift32(&seed) % nwords], i);
+
+    todo_entry* entry = mem_alloc(MEM_ENTRIES, sizeof(todo_entry));
+    init_entry(entry);
+    entry->id = i + 1;
+    entry->desc = mem_strdup(MEM_DESCRIPTIONS, desc);
+    entry->date = mem_strdup(MEM_DATES, "01.01.2024, 12:00");
+    entry->completed = (xorshift32(&seed) % 4) == 0;
+    entry->priority = (entry_priority)(xorshift32(&seed) % PRIORITY_COUNT);
+    // Roughly one in eight entries carries each tag
+    entry->tags = 0;
+    for(uint32_t t = 0; t < ntags; t++) {
+      if(xorshift32(&seed) % 8 == 0) entry->tags |= 1ULL << t;
+    }
+    // Some entries are due at a fixed date in the past, so there 
+    // are overdue entries without depending on the clock.
+    entry->due = xorshift32(&seed) % 16 == 0 ? 1704204000 : 0;
+    // In a tree every tenth entry is a project with the following 
+    // nine entries as its subtasks, every other project is collapsed.
+    if(tree) {
+      entry->depth = i % 10 == 0 ? 0 : 1;
+      entry->collapsed = entry->depth == 0 && (i / 10) % 2 == 1;
+    }
+    entries_da_push(da, entry);
+  }
+  init_tree(da);
+  sort_entries_by_priority(da);
+}
+
 int 
 main(int argc, char** argv) {
   // Handle terminal interface
-  if(argc > 1) {
-    initentries();
+  if(argc > 1 && !is_gui_option(argv[1])) {
+    // Selecting the list the command operates on
+    if(strcmp(argv[1], "--list-name") == 0 || strcmp(argv[1], "-L") == 0) {
+      if(argc < 4) {
+        print_requires_argument(argv[1], 2);
+        return EXIT_FAILURE;
+      }
+      s.requested_list = argv[2];
+      argv += 2;
+      argc -= 2;
+    }
+
     char* subcmd = argv[1];
     str_to_lower(subcmd);
+    // Listing the lists only needs the manifest
+    if(strcmp(subcmd, "--lists") == 0) {
+      load_manifest();
+      print_lists();
+      return EXIT_SUCCESS;
+    }
+    // Imports & exports stream the data file instead of loading it
+    if(strcmp(subcmd, "--import") == 0 || strcmp(subcmd, "--export") == 0) {
+      if(argc < 3) {
+        print_requires_argument(argv[1], 1);
+        return EXIT_FAILURE;
+      }
+      int32_t format = parse_exchange_format(argc > 3 ? argv[3] : NULL, argv[2]);
+      if(format == -1) {
+        printf("todo: unknown format for '%s' (valid formats: {csv, jsonl, todotxt})\n", argc > 3 ? argv[3] : argv[2]);
+        return EXIT_FAILURE;
+      }
+      if(!select_list()) {
+        return EXIT_FAILURE;
+      }
+      bool ok = strcmp(subcmd, "--import") == 0 ? 
+        import_todo_list(argv[2], (exchange_format)format) : 
+        export_todo_list(argv[2], (exchange_format)format);
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if(strcmp(subcmd, "--export-delta") == 0) {
+      const char* path = "-";
+      uint64_t since = 0;
+      for(int32_t i = 2; i < argc; i++) {
+        if(strcmp(argv[i], "--since") == 0) {
+          if(i + 1 >= argc) {
+            print_requires_argument(argv[i], 1);
+            return EXIT_FAILURE;
+          }
+          since = strtoull(argv[++i], NULL, 10);
+        } else {
+          path = argv[i];
+        }
+      }
+      if(!select_list()) {
+        return EXIT_FAILURE;
+      }
+      return export_delta(path, since) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Statistics are printed without loading the entries
+    if(strcmp(subcmd, "--stats") == 0) {
+      if(!select_list()) {
+        return EXIT_FAILURE;
+      }
+      return print_stats() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if(!initentries()) {
+      return EXIT_FAILURE;
+    }
     if(strcmp(subcmd, "--help") == 0 || strcmp(subcmd, "-h") == 0) {
       printf("Usage: todo [OPTION...] [ARGUMENTS...]\n");
       printf("\t-h, --help                        Open help menu\n");
-      printf("\t-l, --list                        Display todo list\n");
-      printf("\t-a, --add \"[desc]\" [priority]     Add a new task to the todo list\n");
-      printf("\t-r, --remove [idx]                Remove a task with a given index from the list.\n");
+      printf("\t-l, --list [query]                Display todo list, optionally only the tasks matching a query\n");
+      printf("\t-a, --add \"[desc]\" [priority] [tags] Add a new task to the todo list (tags are optional & comma separated)\n");
+      printf("\t-s, --subtask [idx] \"[desc]\" [priority] [tags] Add a subtask to the task with a given index.\n");
+      printf("\t-r, --remove [idx]                Remove a task & its subtasks with a given index from the list.\n");
       printf("\t-d, --done [idx]                  Mark a task with a given index as completed.\n");
       printf("\t-n, --not-done [idx]              Mark a task with a given index as not completed.\n");
-      printf("\t-r, --raise [idx]                 Raises a task with a given index to the top.\n");
+      printf("\t-r, --raise [idx]                 Raises a task with a given index to the top of its siblings.\n");
+      printf("\t--collapse [idx]                  Collapse the subtasks of a task with a given index.\n");
+      printf("\t--expand [idx]                    Expand the subtasks of a task with a given index.\n");
+      printf("\t-t, --tag [idx] [tags]            Tag a task with a given index (comma separated).\n");
+      printf("\t-u, --untag [idx] [tags]          Remove tags from a task with a given index.\n");
+      printf("\t--due [idx] [\"DD.MM.YYYY HH:MM\"]  Set the due date of a task with a given index ('none' clears it).\n");
+      printf("\t--show [idx]                      Display a task with a given index together with its notes.\n");
+      printf("\t--note [idx] [text|-]             Set the notes of a task with a given index ('-' reads stdin, 'none' removes them).\n");
+      printf("\t--stats                           Display task counts, completion ratio & completions per day.\n");
+      printf("\t--mem-report                      Display the memory used by the list, by category.\n");
+      printf("\t--undo                            Undo the last change to the list.\n");
+      printf("\t--redo                            Redo the last undone change.\n");
+      printf("\t--bench-query [query] [count]     Benchmark compiled vs. interpreted query evaluation.\n");
+      printf("\t--lists                           Display all lists and their task counts.\n");
+      printf("\t--import [file|-] [format]        Add the tasks of a CSV, JSON lines or todo.txt file to the list.\n");
+      printf("\t--export [file|-] [format]        Write the list as CSV, JSON lines or todo.txt.\n");
+      printf("\t                                  The format (csv, jsonl, todotxt) defaults to the file extension.\n");
+      printf("\t--export-delta [--since N] [file|-] Write the tasks changed & removed after sequence number N.\n");
+      printf("\t--apply-delta [file|-]            Merge a delta into the list, the latest change of every field wins.\n");
+      printf("\t-L, --list-name [name] [OPTION...] Run an option on the list with the given name.\n");
+      printf("\nGUI options:\n");
+      printf("\t--record [file]                   Record all input events of the session to a file.\n");
+      printf("\t--replay [file]                   Replay a recorded session and report frame timings.\n");
+      printf("\t--synthetic [count]               Number of synthetic tasks to record/replay against.\n");
+      printf("\t--synthetic-shape [flat|tree]     Shape of the synthetic tasks (tree groups them into projects).\n");
+      printf("\t--frame-budget [ms]               Fail the replay if the p95 frame time exceeds the budget.\n");
+      printf("\t--frame-log [file]                Write the time of every replayed frame to a file (CSV).\n");
+      printf("\t--startup-stats                   Report the time spent in every startup phase.\n");
+      printf("\nQueries:\n");
+      printf("\tFields: done, due, overdue, priority (low, medium, high), desc, tag (or #name)\n");
+      printf("\tOperators: = != < <= > >= ~ (desc contains), and, or, not/!, (...)\n");
+      printf("\tExample: todo --list 'priority>=medium and !done and desc~\"deploy\"'\n");
     }
     else if(strcmp(subcmd, "--list") == 0 || strcmp(subcmd, "-l") == 0) {
+      query_program query = {0};
+      if(argc > 2) {
+        char err[128];
+        if(!query_compile(argv[2], &s.tags, &query, err, sizeof(err))) {
+          printf("todo: invalid query: %s\n", err);
+          return EXIT_FAILURE;
+        }
+      }
       printf("======== Your To Do ========\n");
       char* priorities_str[] = {
         "L", "M", "H"
       };
       sort_entries_by_priority(&s.todo_entries);
+      uint32_t listedcount = 0;
       for(uint32_t i = 0; i < s.todo_entries.count; i++) {
         todo_entry* entry = s.todo_entries.entries[i];
-        printf("%i | (%s) [%c]: %s\n", i, priorities_str[entry->priority], entry->completed ? 'x' : ' ', entry->desc);
+        if(!query_eval(&query, entry)) continue;
+        listedcount++;
+        char tagsbuf[INPUT_BUF_SIZE], duebuf[64] = {0};
+        format_tags(&s.tags, entry->tags, tagsbuf, sizeof(tagsbuf));
+        if(entry->due) {
+          char due_date[32];
+          format_due(entry->due, due_date, sizeof(due_date));
+          snprintf(duebuf, sizeof(duebuf), " (%s %s)", entry->overdue ? "OVERDUE since" : "due", due_date);
+        }
+        char progressbuf[64] = {0};
+        if(entry->nsubtasks) {
+          snprintf(progressbuf, sizeof(progressbuf), " [%u/%u]%s", entry->nsubtasks_done, entry->nsubtasks, 
+                   entry->collapsed ? " (collapsed)" : "");
+        }
+        printf("%i | %*s(%s) [%c]: %s%s%s%s%s%s\n", i, entry->depth * 2, "", priorities_str[entry->priority], 
+               entry->completed ? 'x' : ' ', entry->desc, entry->tags ? " " : "", tagsbuf, duebuf, progressbuf, 
+               entry->note_size ? " (notes)" : "");
       }
-      if(!s.todo_entries.count) {
+      if(!listedcount) {
         printf("There is nothing here.\n");
       }
+      query_free(&query);
       printf("============================\n");
     } 
-    else if(strcmp(subcmd, "--add") == 0 || strcmp(subcmd, "-a") == 0) {
-      if(argc < 4) {
-        print_requires_argument(argv[1], 2);
+    else if(strcmp(subcmd, "--add") == 0 || strcmp(subcmd, "-a") == 0 || 
+            strcmp(subcmd, "--subtask") == 0 || strcmp(subcmd, "-s") == 0) {
+      // Subtasks take the index of their parent as the first argument
+      bool subtask = strcmp(subcmd, "--subtask") == 0 || strcmp(subcmd, "-s") == 0;
+      if(argc < 4 + subtask) {
+        print_requires_argument(argv[1], 2 + subtask);
         return EXIT_FAILURE;
       }
+      todo_entry* parent = NULL;
+      if(subtask) {
+        int32_t idx = atoi(argv[2]);
+        if(idx < 0 || idx >= s.todo_entries.count) {
+          printf("todo: index of parent task out of bounds.\n");
+          return EXIT_FAILURE;
+        }
+        parent = s.todo_entries.entries[idx];
+        argv++;
+        argc--;
+      }
       char* desc = argv[2];
       char* priority_str = argv[3];
 
@@ -811,19 +6330,27 @@ main(int argc, char** argv) {
         printf("todo: invalid priority given: '%s' (valid priorities: {low, medium, high})\n", priority_str);
         return EXIT_FAILURE;
       }
-      todo_entry* entry = (todo_entry*)malloc(sizeof(todo_entry));
+      todo_entry* entry = (todo_entry*)mem_alloc(MEM_ENTRIES, sizeof(todo_entry));
+      init_entry(entry);
       entry->priority = priority;
-      entry->desc = desc;
+      entry->desc = mem_strdup(MEM_DESCRIPTIONS, desc);
       entry->completed = false;
-      entry->date = get_command_output(DATE_CMD);
+      entry->date = get_command_output(DATE_CMD, MEM_DATES);
+      entry->tags = argc > 4 ? parse_tags(&s.tags, argv[4], true, NULL) : 0;
 
-      entries_da_push(&s.todo_entries, entry);
-      serialize_todo_list(s.tododata_file, &s.todo_entries);
-
-      printf("todo: added new entry to do list.\n");
+      insert_entry(entry, parent);
+      sort_entries_by_priority(&s.todo_entries);
+      list_op op = make_op(OP_ADD, find_entry(entry));
+      record_op(&op);
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
 
-      free(entry);
-      entry = NULL;
+      if(parent) {
+        printf("todo: added new subtask to '%s'.\n", parent->desc);
+      } else {
+        printf("todo: added new entry to do list.\n");
+      }
     }
     else if(strcmp(subcmd, "--remove") == 0 || strcmp(subcmd, "-r") == 0) {
       if(argc < 3) {
@@ -835,15 +6362,22 @@ main(int argc, char** argv) {
         printf("todo: index for removal out of bounds.\n");
         return EXIT_FAILURE;
       }
-      char* entry_desc = malloc(strlen(s.todo_entries.entries[idx]->desc));
-      strcpy(entry_desc, s.todo_entries.entries[idx]->desc);
+      char* entry_desc = mem_strdup(MEM_DESCRIPTIONS, s.todo_entries.entries[idx]->desc);
 
-      entries_da_remove_i(&s.todo_entries, idx);
-      serialize_todo_list(s.tododata_file, &s.todo_entries);
+      list_op op = make_op(OP_REMOVE, idx);
+      record_op(&op);
+      uint32_t nremoved = remove_entry(idx);
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
 
-      printf("todo: removed item %i ('%s') from list.\n", idx, entry_desc);
+      if(nremoved > 1) {
+        printf("todo: removed item %i ('%s') and its %u subtasks from list.\n", idx, entry_desc, nremoved - 1);
+      } else {
+        printf("todo: removed item %i ('%s') from list.\n", idx, entry_desc);
+      }
 
-      free(entry_desc);
+      mem_free(entry_desc);
       entry_desc = NULL;
     }
     else if(strcmp(subcmd, "--done") == 0 || strcmp(subcmd, "-d") == 0) {
@@ -858,8 +6392,20 @@ main(int argc, char** argv) {
       }
 
       todo_entry* entry = s.todo_entries.entries[idx];
-      entry->completed = true;
-      serialize_todo_list(s.tododata_file, &s.todo_entries);
+      if(!entry->completed) {
+        list_op op = make_op(OP_TOGGLE, idx);
+        op.before = false;
+        op.after = true;
+        record_op(&op);
+        update_progress(entry, 0, 1);
+        touch_entry(entry, SYNC_DONE);
+        entry->completed = true;
+        stats_change(entry, false, entry->priority);
+      }
+      update_deadline(entry);
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
 
       printf("todo: marked item %i ('%s') as done.\n", idx, entry->desc);
     }
@@ -875,8 +6421,20 @@ main(int argc, char** argv) {
       }
 
       todo_entry* entry = s.todo_entries.entries[idx];
-      entry->completed = false;
-      serialize_todo_list(s.tododata_file, &s.todo_entries);
+      if(entry->completed) {
+        list_op op = make_op(OP_TOGGLE, idx);
+        op.before = true;
+        op.after = false;
+        record_op(&op);
+        update_progress(entry, 0, -1);
+        touch_entry(entry, SYNC_DONE);
+        entry->completed = false;
+        stats_change(entry, true, entry->priority);
+      }
+      update_deadline(entry);
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
 
       printf("todo: marked item %i ('%s') as not done.\n", idx, entry->desc);
     }
@@ -891,27 +6449,215 @@ main(int argc, char** argv) {
         return EXIT_FAILURE;
       }
 
-      todo_entry* tmp = s.todo_entries.entries[0];
-      s.todo_entries.entries[0] = s.todo_entries.entries[idx];
-      s.todo_entries.entries[idx] = tmp;
+      todo_entry* entry = s.todo_entries.entries[idx];
+      list_op op = make_op(OP_REORDER, idx);
+      raise_entry(idx);
+      op.pos = find_entry(entry);
+      record_op(&op);
+
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
+
+      printf("todo: raised item %i ('%s') to the top.\n", idx, entry->desc);
+    }
+    else if(strcmp(subcmd, "--collapse") == 0 || strcmp(subcmd, "--expand") == 0) {
+      if(argc < 3) {
+        print_requires_argument(argv[1], 1);
+        return EXIT_FAILURE;
+      }
+      int32_t idx = atoi(argv[2]);
+      if(idx < 0 || idx >= s.todo_entries.count) {
+        printf("todo: index for collapsing out of bounds.\n");
+        return EXIT_FAILURE;
+      }
+
+      todo_entry* entry = s.todo_entries.entries[idx];
+      entry->collapsed = strcmp(subcmd, "--collapse") == 0;
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
+
+      printf("todo: %s the subtasks of item %i ('%s').\n", entry->collapsed ? "collapsed" : "expanded", idx, entry->desc);
+    }
+    else if(strcmp(subcmd, "--due") == 0) {
+      if(argc < 4) {
+        print_requires_argument(argv[1], 2);
+        return EXIT_FAILURE;
+      }
+      int32_t idx = atoi(argv[2]);
+      if(idx < 0 || idx >= s.todo_entries.count) {
+        printf("todo: index for setting the due date out of bounds.\n");
+        return EXIT_FAILURE;
+      }
+      int64_t due = strcmp(argv[3], "none") == 0 ? 0 : parse_due(argv[3]);
+      if(due == -1) {
+        printf("todo: invalid due date given: '%s' (format: DD.MM.YYYY HH:MM)\n", argv[3]);
+        return EXIT_FAILURE;
+      }
+
+      todo_entry* entry = s.todo_entries.entries[idx];
+      list_op op = make_op(OP_DUE, idx);
+      op.before = (uint64_t)entry->due;
+      op.after = (uint64_t)due;
+      record_op(&op);
+      entry->due = due;
+      touch_entry(entry, SYNC_DUE);
+      update_deadline(entry);
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
+
+      if(due) {
+        char due_date[32];
+        format_due(due, due_date, sizeof(due_date));
+        printf("todo: item %i ('%s') is due %s.\n", idx, entry->desc, due_date);
+      } else {
+        printf("todo: item %i ('%s') has no due date anymore.\n", idx, entry->desc);
+      }
+    }
+    else if(strcmp(subcmd, "--show") == 0) {
+      if(argc < 3) {
+        print_requires_argument(argv[1], 1);
+        return EXIT_FAILURE;
+      }
+      int32_t idx = atoi(argv[2]);
+      if(idx < 0 || idx >= s.todo_entries.count) {
+        printf("todo: index for showing out of bounds.\n");
+        return EXIT_FAILURE;
+      }
+      if(!print_notes(idx)) {
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(subcmd, "--note") == 0) {
+      if(argc < 4) {
+        print_requires_argument(argv[1], 2);
+        return EXIT_FAILURE;
+      }
+      int32_t idx = atoi(argv[2]);
+      if(idx < 0 || idx >= s.todo_entries.count) {
+        printf("todo: index for setting notes out of bounds.\n");
+        return EXIT_FAILURE;
+      }
+      // The notes are read from stdin with '-', 'none' removes them
+      exchange_buf buf = {0};
+      exchange_buf_reserve(&buf, 1);
+      if(strcmp(argv[3], "-") == 0) {
+        size_t n;
+        do {
+          exchange_buf_reserve(&buf, EXCHANGE_BUF_INIT_CAP);
+          n = fread(buf.data + buf.len, 1, buf.cap - buf.len, stdin);
+          buf.len += n;
+        } while(n > 0);
+      } else if(strcmp(argv[3], "none") != 0) {
+        uint32_t len = strlen(argv[3]);
+        exchange_buf_reserve(&buf, len);
+        memcpy(buf.data, argv[3], len);
+        buf.len = len;
+      }
+
+      todo_entry* entry = s.todo_entries.entries[idx];
+      bool ok = set_note(entry, buf.data, buf.len);
+      mem_free(buf.data);
+      if(!ok) {
+        return EXIT_FAILURE;
+      }
+      if(entry->note_size) {
+        printf("todo: saved the notes of item %i ('%s'), %u bytes.\n", idx, entry->desc, entry->note_size);
+      } else {
+        printf("todo: removed the notes of item %i ('%s').\n", idx, entry->desc);
+      }
+    }
+    else if(strcmp(subcmd, "--undo") == 0 || strcmp(subcmd, "--redo") == 0) {
+      bool redo = strcmp(subcmd, "--redo") == 0;
+      if(!undo(redo)) {
+        printf("todo: nothing to %s.\n", redo ? "redo" : "undo");
+        return EXIT_FAILURE;
+      }
+      printf("todo: %s the last change.\n", redo ? "redid" : "undid");
+    }
+    else if(strcmp(subcmd, "--apply-delta") == 0) {
+      if(argc < 3) {
+        print_requires_argument(argv[1], 1);
+        return EXIT_FAILURE;
+      }
+      if(!apply_delta(argv[2])) {
+        return EXIT_FAILURE;
+      }
+    }
+    else if(strcmp(subcmd, "--mem-report") == 0) {
+      mem_report();
+    }
+    else if(strcmp(subcmd, "--bench-query") == 0) {
+      if(argc < 3) {
+        print_requires_argument(argv[1], 1);
+        return EXIT_FAILURE;
+      }
+      bench_query(argv[2], argc > 3 ? (uint32_t)atoi(argv[3]) : BENCH_QUERY_ENTRIES);
+    }
+    else if(strcmp(subcmd, "--tag") == 0 || strcmp(subcmd, "-t") == 0 ||
+            strcmp(subcmd, "--untag") == 0 || strcmp(subcmd, "-u") == 0) {
+      bool tag = strcmp(subcmd, "--tag") == 0 || strcmp(subcmd, "-t") == 0;
+      if(argc < 4) {
+        print_requires_argument(argv[1], 2);
+        return EXIT_FAILURE;
+      }
+      int32_t idx = atoi(argv[2]);
+      if(idx < 0 || idx >= s.todo_entries.count) {
+        printf("todo: index for tagging out of bounds.\n");
+        return EXIT_FAILURE;
+      }
 
-      serialize_todo_list(s.tododata_file, &s.todo_entries);
+      todo_entry* entry = s.todo_entries.entries[idx];
+      uint64_t mask = parse_tags(&s.tags, argv[3], tag, NULL);
+      list_op op = make_op(OP_TAGS, idx);
+      op.before = entry->tags;
+      if(tag) {
+        entry->tags |= mask;
+      } else {
+        entry->tags &= ~mask;
+      }
+      op.after = entry->tags;
+      record_op(&op);
+      touch_entry(entry, SYNC_TAGS);
+      if(!save_todo_list()) {
+        return EXIT_FAILURE;
+      }
 
-      printf("todo: raised item %i ('%s') to the top.\n", idx, s.todo_entries.entries[0]->desc);
+      char tagsbuf[INPUT_BUF_SIZE];
+      format_tags(&s.tags, entry->tags, tagsbuf, sizeof(tagsbuf));
+      printf("todo: item %i ('%s') is now tagged with: %s\n", idx, entry->desc, entry->tags ? tagsbuf : "nothing");
     }
     else {
       printf("todo: invalid option: '%s'.\n", argv[1]);
       printf("Try todo --help for more information.\n");
       return EXIT_FAILURE;
     }
+    free_list();
+    mem_report_leaks();
     return EXIT_SUCCESS;
   }
 
+  if(!parse_gui_options(argc, argv)) {
+    return EXIT_FAILURE;
+  }
+
+  // The workers load the data file & assets while the window is created
+  start_startup_jobs();
   initwin();
+  s.startup.t_window = bench_now_ms();
   initui();
+  if(!s.startup.data_ok) {
+    terminate();
+    return EXIT_FAILURE;
+  }
+  remind_overdue();
 
   vec4s bgcol = lf_color_to_zto(BG_COLOR);
   while(!glfwWindowShouldClose(s.win)) {
+    double framestart = glfwGetTime();
+    process_deadlines();
     glClear(GL_COLOR_BUFFER_BIT);
     glClearColor(bgcol.r, bgcol.g, bgcol.b, bgcol.a);
 
@@ -933,9 +6679,40 @@ main(int argc, char** argv) {
     lf_div_end();
     lf_end();
 
-    glfwPollEvents();
-    glfwSwapBuffers(s.win);
+    // Replays run flat out, otherwise we sleep until input 
+    // arrives or the next deadline is due. The frame is shown 
+    // before sleeping, not once the next event wakes us up.
+    if(s.input.mode == INPUT_REPLAY) {
+      glfwPollEvents();
+      if(!replay_input_frame()) {
+        glfwSetWindowShouldClose(s.win, true);
+      }
+      glfwSwapBuffers(s.win);
+    } else {
+      glfwSwapBuffers(s.win);
+      wait_events();
+    }
+
+    if(s.input.frame == 0) {
+      s.startup.t_first_frame = bench_now_ms();
+      if(s.startup.stats) {
+        report_startup_stats();
+      }
+    }
+
+    if(s.input.mode == INPUT_REPLAY) {
+      push_frame_time((glfwGetTime() - framestart) * 1000.0);
+    }
+    s.input.frame++;
+  }
+  bool within_budget = true;
+  if(s.input.mode == INPUT_REPLAY) {
+    within_budget = report_frame_timings();
+  }
+  // Replays fail if anything wasn't freed, so leaks are caught by them
+  bool freed = terminate();
+  if(s.input.mode == INPUT_REPLAY && !freed) {
+    within_budget = false;
   }
-  terminate();
-  return EXIT_SUCCESS;
+  return within_budget ? EXIT_SUCCESS : EXIT_FAILURE;
 }